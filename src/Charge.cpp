@@ -5,22 +5,77 @@
 #include <Color.hpp>
 #include <Functions.hpp>
 #include <Vector2.hpp>
+#include <algorithm>
+#include <array>
 #include <cmath>
-#include <unordered_map>
+#include <string>
+
+namespace {
+const std::array<std::string, 1> VARIABLES = {"t"};
+} // namespace
+
+charge::VariableStrength::VariableStrength(const std::string &func)
+    : func(func), program(math::compile(func, VARIABLES)) {}
 
 float charge::VariableStrength::operator()(const double elapsed) const {
-  const std::unordered_map<std::string, float> variables = {
-      {"t", elapsed},
-      {"pi", std::numbers::pi_v<float>},
-      {"e", std::numbers::e_v<float>}
-  };
-  return evaluate(func, variables);
+  const std::array variables{static_cast<float>(elapsed)};
+  return program(variables);
+}
+
+void charge::VariableStrength::sample(
+    const std::span<const double> times, const std::span<float> out
+) const {
+  // Converted in chunks, so the times don't need a buffer of their own
+  std::array<float, math::Program::LANES * 8> chunk;
+
+  for (size_t start = 0; start < times.size(); start += chunk.size()) {
+    const auto count = std::min(chunk.size(), times.size() - start);
+    for (size_t i = 0; i < count; ++i) {
+      chunk[i] = static_cast<float>(times[start + i]);
+    }
+
+    program.run(
+        count,
+        std::span(chunk).first(count),
+        out.subspan(start, count)
+    );
+  }
+}
+
+void charge::Strength::sample(
+    const std::span<const double> times, const std::span<float> out
+) const {
+  for (size_t i = 0; i < times.size(); ++i) {
+    out[i] = (*this)(times[i]);
+  }
+}
+
+void charge::ConstantStrength::sample(
+    [[maybe_unused]] const std::span<const double> times,
+    const std::span<float> out
+) const {
+  std::fill(out.begin(), out.end(), strength);
 }
 
 void Charge::update(
     [[maybe_unused]] const float timeDelta, const double elapsedTime
 ) {
-  _strength = (*strengthFn)(elapsedTime)*_strengthModifier;
+  _strength = strength_at(elapsedTime);
+}
+
+const std::string *Charge::expression() const {
+  const auto *variable =
+      dynamic_cast<const charge::VariableStrength *>(strengthFn.get());
+  return variable != nullptr ? &variable->func : nullptr;
+}
+
+void Charge::strengths_at(
+    const std::span<const double> times, const std::span<float> out
+) const {
+  strengthFn->sample(times, out);
+  for (auto &strength : out) {
+    strength *= _strengthModifier;
+  }
 }
 
 void Charge::draw() const {
@@ -38,13 +93,10 @@ void Charge::draw() const {
   screen_position.DrawCircle(radius - 1, color);
 
   // text
-  auto msg = std::format("{:.2G} C", _strength);
-  int width = raylib::MeasureText(msg, FONT_SIZE_TINY);
-  raylib::DrawText(
-      msg,
-      screen_position.x - width / 2.f,
-      screen_position.y - static_cast<float>(FONT_SIZE_TINY) / 2,
-      FONT_SIZE_TINY,
+  label.update(round_significant(_strength, 2));
+  label.draw_centered(
+      {screen_position.x,
+       screen_position.y - static_cast<float>(FONT_SIZE_TINY) / 2},
       raylib::Color::RayWhite()
   );
 }
@@ -1,8 +1,12 @@
 #pragma once
+#include "Label.hpp"
+#include "MathEval.hpp"
+#include "defs.hpp"
 #include <Color.hpp>
 #include <Vector2.hpp>
 #include <format>
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
 
@@ -11,6 +15,10 @@ namespace charge {
 class Strength {
 public:
   virtual float operator()(const double elapsed) const = 0;
+  /// Strengths at many times at once, `out[i]` at `times[i]`
+  virtual void sample(
+      const std::span<const double> times, const std::span<float> out
+  ) const;
   virtual ~Strength() = default;
 };
 
@@ -20,14 +28,25 @@ public:
   float operator()([[maybe_unused]] const double elapsed) const final {
     return strength;
   }
+  void sample(
+      const std::span<const double> times, const std::span<float> out
+  ) const final;
   const float strength;
 };
 
 class VariableStrength : public Strength {
 public:
-  explicit VariableStrength(const std::string &func) : func(func) {}
+  /// @throws parser_exception when `func` isn't a valid expression
+  explicit VariableStrength(const std::string &func);
   float operator()(const double elapsed) const final;
+  void sample(
+      const std::span<const double> times, const std::span<float> out
+  ) const final;
   const std::string func;
+
+private:
+  /// `func` compiled with the time as its only variable
+  math::Program program;
 };
 
 } // namespace charge
@@ -85,12 +104,35 @@ public:
   Charge &operator=(Charge &&) = default;
 
   void update(const float timeDelta, const double elapsedTime);
+  /// Update with the value of the strength function, evaluated elsewhere
+  void update(const float baseStrength) {
+    _strength = baseStrength * _strengthModifier;
+  }
   void draw() const;
 
   raylib::Vector2 position() const { return _position; }
   void position(raylib::Vector2 position) { _position = position; }
-  void modifier(float modifier) { _strengthModifier *= modifier; }
+  raylib::Vector2 velocity() const { return _velocity; }
+  void velocity(raylib::Vector2 velocity) { _velocity = velocity; }
+  float mass() const { return _mass; }
+  void mass(float mass) { _mass = mass; }
+  float modifier() const { return _strengthModifier; }
+  void modifier(float modifier) {
+    _strengthModifier *= modifier;
+    // Constant strengths aren't updated every frame
+    _strength *= modifier;
+  }
   float strength() const { return _strength; }
+  /// Expression of the strength function, if it isn't constant
+  const std::string *expression() const;
+  /// Strength at an arbitrary time, independent of the last update
+  float strength_at(const double elapsedTime) const {
+    return (*strengthFn)(elapsedTime) * _strengthModifier;
+  }
+  /// Strengths at many times at once, `out[i]` at `times[i]`
+  void strengths_at(
+      const std::span<const double> times, const std::span<float> out
+  ) const;
 
   raylib::Vector2 E(const raylib::Vector2 &point) const;
   float potential(const raylib::Vector2 &point) const;
@@ -104,9 +146,12 @@ private:
   float draw_radius() const { return 32.f * std::sqrt(std::abs(_strength)); };
 
   raylib::Vector2 _position;
+  raylib::Vector2 _velocity{};
+  float _mass = 1.f;
   std::unique_ptr<charge::Strength> strengthFn;
   float _strength = 0.f;
   float _strengthModifier = 1.f;
+  mutable Label<float> label{"{:.2G} C", FONT_SIZE_TINY};
   friend struct std::formatter<Charge>;
 };
 
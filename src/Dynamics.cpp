@@ -0,0 +1,305 @@
+#include "Dynamics.hpp"
+#include "defs.hpp"
+#include "field.hpp"
+#include "parallel.hpp"
+#include <Vector2.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ranges>
+
+/**
+ * @brief Field of a point charge with softened distance, so close encounters
+ * don't produce arbitrarily large forces
+ */
+inline raylib::Vector2
+softened_E(const float dx, const float dy, const float strength) {
+  constexpr float SOFTENING_SQR = DYNAMICS_SOFTENING * DYNAMICS_SOFTENING;
+
+  auto distance_sqr = dx * dx + dy * dy + SOFTENING_SQR;
+  auto factor = strength / (distance_sqr * std::sqrt(distance_sqr));
+  return {dx * factor, dy * factor};
+}
+
+void ForceTree::build(
+    const std::span<const float> new_x,
+    const std::span<const float> new_y,
+    const std::span<const float> new_strength
+) {
+  x = new_x;
+  y = new_y;
+  strength = new_strength;
+
+  nodes.clear();
+  next_body.assign(x.size(), NONE);
+
+  if (x.empty())
+    return;
+
+  auto [min_x, max_x] = std::ranges::minmax(x);
+  auto [min_y, max_y] = std::ranges::minmax(y);
+  auto half_size = std::max(max_x - min_x, max_y - min_y) / 2.f + 1.f;
+
+  nodes.push_back(
+      Node{(min_x + max_x) / 2.f, (min_y + max_y) / 2.f, half_size}
+  );
+
+  for (int32_t body = 0; body < static_cast<int32_t>(x.size()); ++body) {
+    insert(body);
+  }
+
+  aggregate();
+}
+
+int32_t ForceTree::child_for(const Node &node, const int32_t body) const {
+  return node.first_child + (x[body] >= node.center_x ? 1 : 0) +
+         (y[body] >= node.center_y ? 2 : 0);
+}
+
+void ForceTree::subdivide(const int32_t node) {
+  // copy, `nodes` gets reallocated below
+  const auto parent = nodes[node];
+  const auto quarter = parent.half_size / 2.f;
+
+  nodes[node].first_child = static_cast<int32_t>(nodes.size());
+  for (int i = 0; i < 4; ++i) {
+    nodes.push_back(Node{
+        parent.center_x + (i & 1 ? quarter : -quarter),
+        parent.center_y + (i & 2 ? quarter : -quarter),
+        quarter
+    });
+  }
+}
+
+void ForceTree::insert(const int32_t body) {
+  int32_t node = 0;
+
+  for (int depth = 0;; ++depth) {
+    if (nodes[node].first_child != NONE) {
+      node = child_for(nodes[node], body);
+      continue;
+    }
+
+    // Coincident charges would be split forever, so leaves at the maximum
+    // depth can hold any number of them
+    if (nodes[node].first_body == NONE || depth >= MAX_DEPTH) {
+      next_body[body] = nodes[node].first_body;
+      nodes[node].first_body = body;
+      return;
+    }
+
+    // Occupied leaf, split it and move its charge one level down
+    subdivide(node);
+
+    auto moved = nodes[node].first_body;
+    nodes[node].first_body = NONE;
+    while (moved != NONE) {
+      auto next = next_body[moved];
+      auto child = child_for(nodes[node], moved);
+      next_body[moved] = nodes[child].first_body;
+      nodes[child].first_body = moved;
+      moved = next;
+    }
+
+    // Continue from the same node, which now has children
+    --depth;
+  }
+}
+
+void ForceTree::aggregate() {
+  // Children are always stored after their parent
+  for (auto &node : nodes | std::views::reverse) {
+    float weighted_x = 0.f;
+    float weighted_y = 0.f;
+
+    if (node.first_child == NONE) {
+      for (auto body = node.first_body; body != NONE; body = next_body[body]) {
+        auto weight = std::abs(strength[body]);
+        weighted_x += x[body] * weight;
+        weighted_y += y[body] * weight;
+        node.strength += strength[body];
+        node.weight += weight;
+      }
+    } else {
+      for (int i = 0; i < 4; ++i) {
+        const auto &child = nodes[node.first_child + i];
+        weighted_x += child.x * child.weight;
+        weighted_y += child.y * child.weight;
+        node.strength += child.strength;
+        node.weight += child.weight;
+      }
+    }
+
+    if (node.weight > 0.f) {
+      node.x = weighted_x / node.weight;
+      node.y = weighted_y / node.weight;
+    } else {
+      node.x = node.center_x;
+      node.y = node.center_y;
+    }
+  }
+}
+
+raylib::Vector2 ForceTree::E(const int32_t body) const {
+  constexpr float THETA_SQR = DYNAMICS_TREE_THETA * DYNAMICS_TREE_THETA;
+
+  raylib::Vector2 result{};
+
+  if (nodes.empty())
+    return result;
+
+  const auto point_x = x[body];
+  const auto point_y = y[body];
+
+  std::array<int32_t, 4 * MAX_DEPTH + 4> stack;
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    const auto &node = nodes[stack[--top]];
+
+    if (node.first_child == NONE) {
+      for (auto other = node.first_body; other != NONE;
+           other = next_body[other]) {
+        if (other != body) {
+          result += softened_E(
+              point_x - x[other], point_y - y[other], strength[other]
+          );
+        }
+      }
+      continue;
+    }
+
+    auto dx = point_x - node.x;
+    auto dy = point_y - node.y;
+    auto size = 2.f * node.half_size;
+
+    auto inside = std::abs(point_x - node.center_x) <= node.half_size &&
+                  std::abs(point_y - node.center_y) <= node.half_size;
+
+    if (!inside && size * size < THETA_SQR * (dx * dx + dy * dy)) {
+      // Far enough to be seen as a single charge
+      result += softened_E(dx, dy, node.strength);
+    } else {
+      for (int i = 0; i < 4; ++i) {
+        stack[top++] = node.first_child + i;
+      }
+    }
+  }
+
+  return result;
+}
+
+void Dynamics::load(const std::span<const Charge> &charges) {
+  const auto count = charges.size();
+
+  if (x.size() != count) {
+    for (auto *buffer :
+         {&x, &y, &vx, &vy, &ax, &ay, &next_ax, &next_ay, &strength, &mass}) {
+      buffer->resize(count);
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto &charge = charges[i];
+    x[i] = charge.position().x;
+    y[i] = charge.position().y;
+    vx[i] = charge.velocity().x;
+    vy[i] = charge.velocity().y;
+    strength[i] = charge.strength();
+    mass[i] = charge.mass();
+  }
+}
+
+void Dynamics::accelerations(
+    const double time, std::vector<float> &out_x, std::vector<float> &out_y
+) {
+  const auto count = x.size();
+  const auto use_tree = count >= DYNAMICS_TREE_THRESHOLD;
+
+  if (use_tree)
+    tree.build(x, y, strength);
+
+  // Already in the units of the scaled field of the charges
+  background_x.assign(count, 0.f);
+  background_y.assign(count, 0.f);
+  field::background().add_E(
+      x, y, static_cast<float>(time), background_x, background_y
+  );
+
+  parallel::for_each(
+      count,
+      [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i) {
+          raylib::Vector2 e{};
+
+          if (use_tree) {
+            e = tree.E(static_cast<int32_t>(i));
+          } else {
+            for (size_t j = 0; j < count; ++j) {
+              if (j != i)
+                e += softened_E(x[i] - x[j], y[i] - y[j], strength[j]);
+            }
+          }
+
+          e = e * field::FIELD_SCALE +
+              raylib::Vector2{background_x[i], background_y[i]};
+
+          auto factor = strength[i] * DYNAMICS_FORCE_SCALE / mass[i];
+          out_x[i] = e.x * factor;
+          out_y[i] = e.y * factor;
+        }
+      },
+      // Threads don't pay off for a handful of charges
+      count >= 64
+  );
+}
+
+void Dynamics::update(
+    const float timeDelta,
+    const double elapsedTime,
+    const std::span<Charge> &charges
+) {
+  constexpr float dt = DYNAMICS_TIME_STEP;
+
+  // Cap the number of steps, so a long frame can't make the next one longer
+  accumulator = std::min(
+      accumulator + timeDelta, DYNAMICS_MAX_STEPS * DYNAMICS_TIME_STEP
+  );
+  if (accumulator < dt)
+    return;
+
+  // Charges may have been moved or changed since the last update
+  load(charges);
+
+  // The charges lag behind by the time, that's left to integrate
+  auto time = elapsedTime - accumulator;
+  accelerations(time, ax, ay);
+
+  const auto count = x.size();
+
+  while (accumulator >= dt) {
+    for (size_t i = 0; i < count; ++i) {
+      x[i] += vx[i] * dt + 0.5f * ax[i] * dt * dt;
+      y[i] += vy[i] * dt + 0.5f * ay[i] * dt * dt;
+    }
+
+    time += dt;
+    accelerations(time, next_ax, next_ay);
+
+    for (size_t i = 0; i < count; ++i) {
+      vx[i] += 0.5f * (ax[i] + next_ax[i]) * dt;
+      vy[i] += 0.5f * (ay[i] + next_ay[i]) * dt;
+    }
+
+    std::swap(ax, next_ax);
+    std::swap(ay, next_ay);
+
+    accumulator -= dt;
+  }
+
+  for (auto [i, charge] : charges | std::views::enumerate) {
+    charge.position({x[i], y[i]});
+    charge.velocity({vx[i], vy[i]});
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "Charge.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Barnes–Hut quadtree over a set of point charges
+ *
+ * Approximates the field of distant groups of charges by a single charge in
+ * their center, which makes evaluating the field in all charges O(N log N).
+ */
+class ForceTree {
+public:
+  void build(
+      const std::span<const float> x,
+      const std::span<const float> y,
+      const std::span<const float> strength
+  );
+
+  /**
+   * @brief Field in the position of charge `body`, excluding its own
+   */
+  raylib::Vector2 E(const int32_t body) const;
+
+private:
+  static constexpr int32_t NONE = -1;
+  static constexpr int MAX_DEPTH = 24;
+
+  struct Node {
+    // square cell
+    float center_x;
+    float center_y;
+    float half_size;
+
+    // aggregated charge, positioned in the center of the absolute charge
+    float x = 0.f;
+    float y = 0.f;
+    float strength = 0.f;
+    float weight = 0.f;
+
+    // children are stored next to each other, starting at `first_child`
+    int32_t first_child = NONE;
+    // head of the linked list of charges in a leaf
+    int32_t first_body = NONE;
+  };
+
+  void insert(const int32_t body);
+  void subdivide(const int32_t node);
+  int32_t child_for(const Node &node, const int32_t body) const;
+  void aggregate();
+
+  std::span<const float> x{};
+  std::span<const float> y{};
+  std::span<const float> strength{};
+
+  std::vector<Node> nodes{};
+  std::vector<int32_t> next_body{};
+};
+
+/**
+ * @brief Moves the charges under their mutual Coulomb forces and the field of
+ * the background
+ *
+ * Integrates with velocity Verlet in fixed steps of simulation time. Forces are
+ * summed directly for small scenes and through `ForceTree` for large ones.
+ */
+class Dynamics {
+public:
+  void update(
+      const float timeDelta,
+      const double elapsedTime,
+      const std::span<Charge> &charges
+  );
+
+private:
+  void load(const std::span<const Charge> &charges);
+  void accelerations(
+      const double time, std::vector<float> &out_x, std::vector<float> &out_y
+  );
+
+  float accumulator = 0.f;
+
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> vx{};
+  std::vector<float> vy{};
+  std::vector<float> ax{};
+  std::vector<float> ay{};
+  std::vector<float> next_ax{};
+  std::vector<float> next_ay{};
+  std::vector<float> strength{};
+  std::vector<float> mass{};
+  std::vector<float> background_x{};
+  std::vector<float> background_y{};
+
+  ForceTree tree{};
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Branch-free polynomial approximations of elementary functions
+ *
+ * They avoid calls into libm and only use arithmetic, conversions and selects,
+ * so loops over arrays of floats calling them get vectorized by the compiler.
+ * Coefficients are the single precision minimax polynomials from Cephes, the
+ * results are within a few ulp of `std::` for arguments used in expressions.
+ * Trigonometric functions lose precision for |x| over about 10^6 and clamp
+ * arguments over 4 * 10^6, they return NaN for infinite arguments like `std::`.
+ */
+namespace math::fast {
+
+/// Round to the nearest integer, for |x| < 2^22
+inline float round(const float x) {
+  constexpr float MAGIC = 12582912.f; // 1.5 * 2^23
+  return (x + MAGIC) - MAGIC;
+}
+
+/// `x` reduced to [-pi/4, pi/4], and the quadrant it was reduced from. NaN
+/// for infinite and NaN `x`, so the functions built on it return NaN too.
+inline float reduce_quadrant(const float x, int32_t &quadrant) {
+  constexpr float TWO_OVER_PI = 0.636619772367581343f;
+  // pi/2 split, so the products with small quadrants are exact
+  constexpr float HALF_PI_1 = 1.5703125f;
+  constexpr float HALF_PI_2 = 4.837512969970703125e-4f;
+  constexpr float HALF_PI_3 = 7.54978995489188216e-8f;
+  // Keeps the quadrant in the range of `round`, far beyond any precision
+  constexpr float MAX = 4e6f;
+
+  // Clamped so the conversion below stays defined, NaN ends up at -MAX
+  const auto clamped = std::fmin(std::fmax(x, -MAX), MAX);
+  const auto k = round(clamped * TWO_OVER_PI);
+  quadrant = static_cast<int32_t>(k);
+  const auto r = ((clamped - k * HALF_PI_1) - k * HALF_PI_2) - k * HALF_PI_3;
+
+  // False for infinities and NaN
+  const auto finite = std::fabs(x) <= std::numeric_limits<float>::max();
+  return finite ? r : std::numeric_limits<float>::quiet_NaN();
+}
+
+/// Sine of `r` in [-pi/4, pi/4]
+inline float sin_polynomial(const float r) {
+  const auto z = r * r;
+  return r + r * z *
+                 (-1.6666654611e-1f +
+                  z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+}
+
+/// Cosine of `r` in [-pi/4, pi/4]
+inline float cos_polynomial(const float r) {
+  const auto z = r * r;
+  return 1.f - 0.5f * z +
+         z * z *
+             (4.166664568298827e-2f +
+              z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+}
+
+inline float sin(const float x) {
+  int32_t quadrant;
+  const auto r = reduce_quadrant(x, quadrant);
+  const auto value = (quadrant & 1) ? cos_polynomial(r) : sin_polynomial(r);
+  return (quadrant & 2) ? -value : value;
+}
+
+inline float cos(const float x) {
+  int32_t quadrant;
+  const auto r = reduce_quadrant(x, quadrant);
+  const auto value = (quadrant & 1) ? sin_polynomial(r) : cos_polynomial(r);
+  return ((quadrant + 1) & 2) ? -value : value;
+}
+
+inline float tan(const float x) {
+  int32_t quadrant;
+  const auto r = reduce_quadrant(x, quadrant);
+  const auto s = sin_polynomial(r);
+  const auto c = cos_polynomial(r);
+  return (quadrant & 1) ? -c / s : s / c;
+}
+
+inline float exp(const float x) {
+  constexpr float LOG2_E = 1.44269504088896341f;
+  constexpr float LN_2_HI = 0.693359375f;
+  constexpr float LN_2_LO = -2.12194440e-4f;
+  constexpr float MAX = 88.3762626647949f;
+  constexpr float MIN = -87.3365447504019f;
+
+  // Clamped so the exponent of the result stays normal
+  const auto clamped = std::fmin(std::fmax(x, MIN), MAX);
+  const auto k = round(clamped * LOG2_E);
+  const auto r = (clamped - k * LN_2_HI) - k * LN_2_LO;
+
+  const auto polynomial =
+      1.f + r +
+      r * r *
+          (5.0000001201e-1f +
+           r * (1.6666665459e-1f +
+                r * (4.1665795894e-2f +
+                     r * (8.3334519073e-3f +
+                          r * (1.3981999507e-3f + r * 1.9875691500e-4f)))));
+  const auto scale =
+      std::bit_cast<float>((static_cast<int32_t>(k) + 127) << 23);
+
+  auto result = polynomial * scale;
+  result = x > MAX ? std::numeric_limits<float>::infinity() : result;
+  result = x < MIN ? 0.f : result;
+  return x != x ? x : result;
+}
+
+inline float log(const float x) {
+  constexpr float SQRT_HALF = 0.707106781186547524f;
+  constexpr float LN_2_HI = 0.693359375f;
+  constexpr float LN_2_LO = -2.12194440e-4f;
+
+  // x = m * 2^e, with m in [0.5, 1)
+  const auto bits = std::bit_cast<int32_t>(x);
+  auto e = static_cast<float>(((bits >> 23) & 0xff) - 126);
+  auto m = std::bit_cast<float>((bits & 0x007fffff) | 0x3f000000);
+
+  // Shifted to [sqrt(0.5) - 1, sqrt(2) - 1), where the polynomial is accurate
+  const auto small = m < SQRT_HALF;
+  e = small ? e - 1.f : e;
+  m = small ? m + m - 1.f : m - 1.f;
+
+  const auto z = m * m;
+  auto y = m * z *
+           (3.3333331174e-1f +
+            m * (-2.4999993993e-1f +
+                 m * (2.0000714765e-1f +
+                      m * (-1.6668057665e-1f +
+                           m * (1.4249322787e-1f +
+                                m * (-1.2420140846e-1f +
+                                     m * (1.1676998740e-1f +
+                                          m * (-1.1514610310e-1f +
+                                               m * 7.0376836292e-2f))))))));
+  y += e * LN_2_LO - 0.5f * z;
+  auto result = m + y + e * LN_2_HI;
+
+  result = x == 0.f ? -std::numeric_limits<float>::infinity() : result;
+  result = x < 0.f ? std::numeric_limits<float>::quiet_NaN() : result;
+  result = x == std::numeric_limits<float>::infinity() ? x : result;
+  return x != x ? x : result;
+}
+
+inline float pow(const float base, const float exponent) {
+  constexpr float INTEGRAL = 16777216.f; // 2^24, all larger floats are even
+
+  auto result = exp(exponent * log(std::fabs(base)));
+
+  // Negative bases only have real powers with whole exponents
+  const auto clamped = std::fmin(std::fmax(exponent, -INTEGRAL), INTEGRAL);
+  const auto whole = static_cast<int32_t>(clamped);
+  const auto integer =
+      static_cast<float>(whole) == clamped || std::fabs(exponent) >= INTEGRAL;
+  const auto negative = integer && (whole & 1) ? -result : result;
+  result = base < 0.f
+               ? (integer ? negative : std::numeric_limits<float>::quiet_NaN())
+               : result;
+
+  return exponent == 0.f ? 1.f : result;
+}
+
+} // namespace math::fast
@@ -2,11 +2,11 @@
 #include "Vector2.hpp"
 #include "defs.hpp"
 #include "field.hpp"
-#include "parallel.hpp"
 #include "raylib.h"
 #include <algorithm>
 #include <cmath>
 #include <functional>
+#include <mutex>
 #include <optional>
 #include <ranges>
 #include <span>
@@ -17,16 +17,16 @@ namespace ranges = std::ranges;
 /**
  * @brief Calculate a field line given set of parameters
  *
- * @param charges Reference to span of factors in the field.
+ * @param points Buffer the line is written into, cleared beforehand.
  * @param start_point Starting point of the line.
  * @param field_function Function the describes the "direction" of the field
  * in given point.
  * @param end_point_function Return the end point if the line should end
  * already.
  * @param direction Direction of the line relative to the field function.
- * @return the line
  */
-FieldLines::Line calculate_line(
+void calculate_line(
+    std::vector<Vector2> &points,
     const raylib::Vector2 &start_point,
     const raylib::Vector2 &start_direction,
     const std::function<raylib::Vector2(raylib::Vector2)> &field_function,
@@ -37,9 +37,7 @@ FieldLines::Line calculate_line(
 ) {
   constexpr size_t STEPS = 1000;
 
-  std::vector<Vector2> points;
-  points.reserve(STEPS);
-
+  points.clear();
   points.push_back(start_point);
 
   raylib::Vector2 position = start_point + start_direction;
@@ -63,36 +61,302 @@ FieldLines::Line calculate_line(
 
     position = next_position;
   }
+}
+
+/**
+ * @brief Squared distance of a point from a line segment
+ */
+float segment_distance_sqr(
+    const raylib::Vector2 point,
+    const raylib::Vector2 a,
+    const raylib::Vector2 b
+) {
+  auto ab = b - a;
+  auto length_sqr = ab.LengthSqr();
+  if (length_sqr == 0.f)
+    return (point - a).LengthSqr();
+
+  auto t = std::clamp((point - a).DotProduct(ab) / length_sqr, 0.f, 1.f);
+  return (point - (a + ab * t)).LengthSqr();
+}
+
+/**
+ * @brief Mark points of a polyline, that should be kept after
+ * Douglas–Peucker simplification.
+ *
+ * @param points The polyline.
+ * @param tolerance Maximum allowed distance of a dropped point from the
+ * simplified line.
+ * @param keep Output mask, `1` for every kept point.
+ * @param stack Scratch buffer for the pending segments.
+ *
+ * Iterative, so long lines can't overflow the call stack.
+ */
+void simplify_line(
+    const std::span<const Vector2> points,
+    const float tolerance,
+    std::vector<uint8_t> &keep,
+    std::vector<std::pair<size_t, size_t>> &stack
+) {
+  keep.assign(points.size(), 0);
+  if (points.size() <= 2) {
+    ranges::fill(keep, 1);
+    return;
+  }
+
+  const auto tolerance_sqr = tolerance * tolerance;
+
+  keep.front() = 1;
+  keep.back() = 1;
+
+  stack.clear();
+  stack.emplace_back(0, points.size() - 1);
+
+  while (!stack.empty()) {
+    auto [first, last] = stack.back();
+    stack.pop_back();
+
+    auto max_distance = 0.f;
+    auto max_index = first;
+
+    for (size_t i = first + 1; i < last; ++i) {
+      auto distance =
+          segment_distance_sqr(points[i], points[first], points[last]);
+      if (distance > max_distance) {
+        max_distance = distance;
+        max_index = i;
+      }
+    }
+
+    if (max_distance > tolerance_sqr) {
+      keep[max_index] = 1;
+      stack.emplace_back(first, max_index);
+      stack.emplace_back(max_index, last);
+    }
+  }
+}
+
+void FieldLines::push_line(
+    const std::span<const Vector2> points, const float tolerance
+) {
+  simplify_line(points, tolerance, keep_buffer, segment_stack);
+
+  auto &[vertices, lines] = back;
+
+  Line line{vertices.size(), 0, {}};
+  auto min = points.front();
+  auto max = points.front();
+
+  for (const auto &[point, keep] : views::zip(points, keep_buffer)) {
+    if (!keep)
+      continue;
+
+    vertices.push_back(point);
+    min = {std::min(min.x, point.x), std::min(min.y, point.y)};
+    max = {std::max(max.x, point.x), std::max(max.y, point.y)};
+  }
+
+  line.count = vertices.size() - line.offset;
+  line.bounds = raylib::Rectangle{min.x, min.y, max.x - min.x, max.y - min.y};
+  lines.push_back(line);
+}
+
+/**
+ * @brief Trace a streamline from a seed in a single direction
+ *
+ * @param points Buffer the line is written into (excluding the seed), cleared
+ * beforehand.
+ * @param seed Starting point of the line.
+ * @param field_function Function the describes the "direction" of the field
+ * in given point.
+ * @param end_point_function Return the end point if the line should end
+ * already.
+ * @param should_stop Return true if the line shouldn't continue to the point.
+ * @param direction Direction of the line relative to the field function.
+ * @param max_steps Maximum number of points of the line.
+ */
+void trace_streamline(
+    std::vector<Vector2> &points,
+    const raylib::Vector2 &seed,
+    const std::function<raylib::Vector2(raylib::Vector2)> &field_function,
+    const std::function<std::optional<raylib::Vector2>(raylib::Vector2)>
+        &end_point_function,
+    const std::function<bool(raylib::Vector2)> &should_stop,
+    const float direction,
+    const size_t max_steps
+) {
+  points.clear();
+
+  raylib::Vector2 position = seed;
+
+  while (points.size() < max_steps) {
+    auto sample = field_function(position) * direction;
+    if (sample.LengthSqr() == 0.f)
+      break;
+
+    auto next_position = position + sample.Scale(2.f / sample.Length());
+
+    if (auto end_point = end_point_function(next_position);
+        end_point.has_value()) {
+      points.push_back(end_point.value());
+      break;
+    }
+
+    if (should_stop(next_position))
+      break;
+
+    points.push_back(next_position);
+    position = next_position;
+  }
+}
 
-  return points;
+FieldLines::FieldLines(
+    const size_t lines_per_charge,
+    const Seeding seeding,
+    const raylib::Color &color
+)
+    : lines_per_charge(lines_per_charge), seeding(seeding), color(color),
+      worker([this](std::stop_token stop) { run(stop); }) {}
+
+bool FieldLines::Request::operator==(const Request &other) const {
+  return sources == other.sources && world_target == other.world_target &&
+         view.x == other.view.x && view.y == other.view.y &&
+         view.width == other.view.width && view.height == other.view.height &&
+         zoom == other.zoom && key == other.key;
+}
+
+size_t FieldLines::Buffer::size_bytes() const {
+  return vertices.size() * sizeof(Vector2) + lines.size() * sizeof(Line);
 }
 
 void FieldLines::update(
-    const std::span<const Charge> &charges, const raylib::Vector2 world_target
+    const std::span<const Charge> &charges,
+    const double elapsedTime,
+    const raylib::Vector2 world_target,
+    const raylib::Rectangle &view,
+    const float zoom
 ) {
-  field_lines.clear();
-  equipotencial_lines.clear();
+  {
+    std::scoped_lock lock{mutex};
+    if (has_finished) {
+      std::swap(front, finished);
+      has_finished = false;
+    }
+  }
 
-  auto field_function = [charges](auto point) {
-    return field::E(point, charges);
-  };
+  shown = nullptr;
+  std::optional<FrameCache::Key> key{};
 
-  auto end_point_function = [charges](raylib::Vector2 point) {
-    auto charge = std::ranges::find_if(charges, [point](auto &ch) {
-      return point.CheckCollision(ch.position(), 1.f);
-    });
-    return charge != charges.end() ? std::optional(charge->position())
-                                   : std::nullopt;
-  };
+  if (cache != nullptr) {
+    if (cached_generation != cache->generation()) {
+      cached.clear();
+      cached_generation = cache->generation();
+    }
+
+    if (front.key && front.key->generation == cached_generation &&
+        !cached.contains(front.key->phase) &&
+        cache->reserve(front.size_bytes()))
+      cached.emplace(front.key->phase, front);
+
+    key = cache->key(elapsedTime);
+  }
+
+  if (key) {
+    if (const auto it = cached.find(key->phase); it != cached.end())
+      shown = &it->second;
+
+    // Trace the first missing phase from the current one on. Traces usually
+    // take longer than a phase, so tracing only the current ones would leave
+    // most of them missing.
+    const auto phases = cache->phase_count();
+    if (cached.size() >= phases)
+      return;
+    while (cached.contains(key->phase)) {
+      key->phase = (key->phase + 1) % phases;
+    }
+
+    staging.sources.assign_at(charges, cache->time(*key));
+  } else {
+    staging.sources.assign(charges, elapsedTime);
+  }
+
+  staging.key = key;
+  staging.world_target = world_target;
+  staging.view = view;
+  staging.zoom = zoom;
+
+  // Nothing changed since the last snapshot, the lines would be the same
+  if (staging == submitted)
+    return;
+
+  submitted = staging;
+
+  {
+    std::scoped_lock lock{mutex};
+    // Replaces the previous snapshot, if the worker didn't pick it up yet
+    std::swap(pending, staging);
+    has_pending = true;
+  }
+  condition.notify_one();
+}
+
+void FieldLines::run(std::stop_token stop) {
+  while (true) {
+    {
+      std::unique_lock lock{mutex};
+      if (!condition.wait(lock, stop, [this] { return has_pending; }))
+        return;
+
+      std::swap(current, pending);
+      has_pending = false;
+    }
+
+    trace(current);
+
+    {
+      std::scoped_lock lock{mutex};
+      std::swap(back, finished);
+      has_finished = true;
+    }
+  }
+}
+
+void FieldLines::trace(const Request &request) {
+  const auto &sources = request.sources;
+
+  back.vertices.clear();
+  back.lines.clear();
+  back.key = request.key;
+
+  // Half a pixel on screen is not noticeable
+  const auto tolerance = 0.5f / request.zoom;
 
   // count number of positive vs negative charges
-  size_t positive_charges = ranges::count_if(charges, [](auto &charge) {
-    return charge.strength() > 0.f;
-  });
+  size_t positive_charges =
+      ranges::count_if(sources.strength, [](auto strength) {
+        return strength > 0.f;
+      });
+
+  auto direction = (2 * positive_charges >= sources.size()) ? 1.f : -1.f;
+
+  if (seeding == Seeding::EvenlySpaced) {
+    trace_evenly_spaced(request, direction, tolerance);
+    return;
+  }
+
+  auto field_function = [&sources](auto point) {
+    return field::E(point, sources);
+  };
 
-  auto direction = (2 * positive_charges >= charges.size()) ? 1.f : -1.f;
+  auto end_point_function = [&sources](raylib::Vector2 point) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+      if (point.CheckCollision(sources.position(i), 1.f))
+        return std::optional(sources.position(i));
+    }
+    return std::optional<raylib::Vector2>();
+  };
 
-  for (const auto &[i, charge] : charges | views::enumerate | views::as_const) {
+  for (size_t i = 0; i < sources.size(); ++i) {
     // Start with slight offset to align less with axis and other charges
     float initial_angle_offset = 0.1f;
 
@@ -101,26 +365,174 @@ void FieldLines::update(
     for (size_t j = 0; j < lines_per_charge; ++j) {
       offset = offset.Rotate(2 * std::numbers::pi_v<float> / lines_per_charge);
 
-      auto line = calculate_line(
-          charge.position(),
+      calculate_line(
+          trace_buffer,
+          sources.position(i),
           offset,
           field_function,
           end_point_function,
           direction,
-          world_target
+          request.world_target
       );
 
-      field_lines.push_back(line);
+      push_line(trace_buffer, tolerance);
+    }
+  }
+}
+
+/**
+ * Places the lines using the Jobard–Lefer algorithm: each line is traced from
+ * a seed in both directions until it comes closer than the test distance to
+ * an already accepted line, and new seeds are placed at the separation
+ * distance on both sides of every accepted line.
+ */
+void FieldLines::trace_evenly_spaced(
+    const Request &request, const float direction, const float tolerance
+) {
+  constexpr size_t STEPS = 1000;
+
+  const auto &sources = request.sources;
+  const auto &view = request.view;
+  const auto zoom = request.zoom;
+
+  const auto separation = LINE_SEPARATION / zoom;
+  const auto test_distance = separation * LINE_TEST_RATIO;
+
+  // Let the lines continue a bit beyond the edges of the screen
+  const raylib::Rectangle bounds{
+      view.x - separation,
+      view.y - separation,
+      view.width + 2.f * separation,
+      view.height + 2.f * separation
+  };
+
+  occupancy.reset(bounds, separation);
+  seeds.clear();
+
+  // Lines converge near charges, so they are allowed to get closer there,
+  // otherwise no line would ever reach a charge.
+  auto near_charge = [&sources, separation](raylib::Vector2 point) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+      if (point.CheckCollision(sources.position(i), 2.f * separation))
+        return true;
+    }
+    return false;
+  };
+
+  auto field_function = [&sources](auto point) {
+    return field::E(point, sources);
+  };
+
+  auto end_point_function = [&sources](raylib::Vector2 point) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+      if (point.CheckCollision(sources.position(i), 1.f))
+        return std::optional(sources.position(i));
+    }
+    return std::optional<raylib::Vector2>();
+  };
+
+  auto should_stop = [this, &near_charge, test_distance](auto point) {
+    return !occupancy.contains(point) ||
+           (!near_charge(point) && occupancy.is_occupied(point, test_distance));
+  };
+
+  // Start around the charges, strongest first
+  auto order = views::iota(0uz, sources.size()) | ranges::to<std::vector>();
+  ranges::sort(order, std::greater<>(), [&sources](auto i) {
+    return std::abs(sources.strength[i]);
+  });
+
+  for (const auto i : order) {
+    auto offset = raylib::Vector2{0.f, 5.f}.Rotate(0.1f);
+
+    for (size_t j = 0; j < lines_per_charge; ++j) {
+      offset = offset.Rotate(2 * std::numbers::pi_v<float> / lines_per_charge);
+      seeds.push_back(sources.position(i) + offset);
     }
   }
+
+  if (seeds.empty())
+    seeds.emplace_back(view.x + view.width / 2.f, view.y + view.height / 2.f);
+
+  // Seeds of the rings around the charges are all close together, they'd
+  // reject each other. Later seeds are tested like any other point.
+  const auto ring_seeds = seeds.size();
+
+  // Seeds along accepted lines are spaced about half the separation apart
+  const auto seed_stride =
+      std::max(1uz, static_cast<size_t>(separation / 2.f / 2.f));
+
+  size_t vertex_count = 0;
+
+  // `seeds` grows while it's being processed, so iterate by index
+  for (size_t next = 0; next < seeds.size(); ++next) {
+    if (back.lines.size() >= MAX_FIELD_LINES ||
+        vertex_count >= MAX_FIELD_LINE_VERTICES)
+      break;
+
+    const auto seed = seeds[next];
+
+    if (!occupancy.contains(seed) ||
+        (next >= ring_seeds && occupancy.is_occupied(seed, separation)))
+      continue;
+
+    trace_streamline(
+        backward_buffer,
+        seed,
+        field_function,
+        end_point_function,
+        should_stop,
+        -direction,
+        STEPS
+    );
+    trace_streamline(
+        trace_buffer,
+        seed,
+        field_function,
+        end_point_function,
+        should_stop,
+        direction,
+        STEPS
+    );
+
+    // Join both halves into one line starting in the backward end
+    trace_buffer.insert(trace_buffer.begin(), seed);
+    trace_buffer.insert(
+        trace_buffer.begin(), backward_buffer.rbegin(), backward_buffer.rend()
+    );
+
+    if (trace_buffer.size() < 3)
+      continue;
+
+    vertex_count += trace_buffer.size();
+
+    for (const auto &point : trace_buffer) {
+      occupancy.insert(point);
+    }
+
+    for (size_t j = 0; j + 1 < trace_buffer.size(); j += seed_stride) {
+      raylib::Vector2 point = trace_buffer[j];
+      auto tangent = (raylib::Vector2(trace_buffer[j + 1]) - point).Normalize();
+      auto normal = raylib::Vector2{-tangent.y, tangent.x} * separation;
+
+      seeds.push_back(point + normal);
+      seeds.push_back(point - normal);
+    }
+
+    push_line(trace_buffer, tolerance);
+  }
 }
 
-void FieldLines::draw() const {
-  for (const auto &line : field_lines) {
-    draw_line(line);
+void FieldLines::draw(const raylib::Rectangle &view) const {
+  const auto &buffer = shown != nullptr ? *shown : front;
+  for (const auto &line : buffer.lines) {
+    if (line.bounds.CheckCollision(view))
+      draw_line(buffer, line);
   }
 }
 
-void FieldLines::draw_line(const Line &line) const {
-  color.DrawLineStrip(const_cast<Vector2 *>(line.data()), line.size());
+void FieldLines::draw_line(const Buffer &buffer, const Line &line) const {
+  color.DrawLineStrip(
+      const_cast<Vector2 *>(buffer.vertices.data() + line.offset), line.count
+  );
 }
@@ -1,31 +1,137 @@
 #pragma once
 #include "Charge.hpp"
+#include "FrameCache.hpp"
+#include "OccupancyGrid.hpp"
+#include "field.hpp"
 #include <Color.hpp>
+#include <Rectangle.hpp>
 #include <Vector2.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+/**
+ * @brief Field lines of the scene
+ *
+ * The lines are traced on a background thread from a snapshot of the charges.
+ * `update` only hands over a new snapshot and swaps in the newest finished set
+ * of lines, so a slow trace never blocks the frame. Snapshots submitted while
+ * a trace is running replace each other, only the newest one gets traced.
+ *
+ * With a `FrameCache`, lines of periodic scenes are traced at the time of
+ * their phase and kept, so later periods reuse them instead of tracing again.
+ * The worker walks the phases missing in the cache in order from the current
+ * one, also while the shown phases come from it, until the whole period is
+ * cached or the memory runs out.
+ */
 class FieldLines {
 public:
-  using Line = std::vector<Vector2>;
+  /// A single line stored in the shared vertex buffer
+  struct Line {
+    size_t offset;
+    size_t count;
+    raylib::Rectangle bounds;
+  };
+
+  enum class Seeding {
+    /// Fixed number of lines at equal angles around each charge
+    PerCharge,
+    /// Lines placed at roughly constant separation over the whole view
+    EvenlySpaced,
+  };
 
   FieldLines() = default;
   FieldLines(
       const size_t lines_per_charge,
+      const Seeding seeding = Seeding::PerCharge,
       const raylib::Color &color = raylib::Color::White()
-  )
-      : lines_per_charge(lines_per_charge), color(color) {}
+  );
+
+  FieldLines(const FieldLines &) = delete;
+  FieldLines &operator=(const FieldLines &) = delete;
 
   void update(
-      const std::span<const Charge> &charges, const raylib::Vector2 world_target
+      const std::span<const Charge> &charges,
+      const double elapsedTime,
+      const raylib::Vector2 world_target,
+      const raylib::Rectangle &view,
+      const float zoom
   );
-  void draw() const;
+  void draw(const raylib::Rectangle &view) const;
+
+  /// Cache lines of periodic scenes, `nullptr` disables it
+  void cache_with(FrameCache *new_cache) { cache = new_cache; }
 
 private:
-  void draw_line(const Line &lines) const;
+  struct Request {
+    field::Sources sources{};
+    raylib::Vector2 world_target{};
+    raylib::Rectangle view{};
+    float zoom = 0.f;
+    std::optional<FrameCache::Key> key{};
+
+    bool operator==(const Request &other) const;
+  };
+
+  // All lines share a single vertex buffer. Buffers are only ever swapped, so
+  // they keep their capacity across frames.
+  struct Buffer {
+    std::vector<Vector2> vertices{};
+    std::vector<Line> lines{};
+    /// Phase the lines were traced for, when they're cached
+    std::optional<FrameCache::Key> key{};
+
+    size_t size_bytes() const;
+  };
+
+  void draw_line(const Buffer &buffer, const Line &line) const;
+
+  void run(std::stop_token stop);
+  void trace(const Request &request);
+  void push_line(const std::span<const Vector2> points, const float tolerance);
+  void trace_evenly_spaced(
+      const Request &request, const float direction, const float tolerance
+  );
 
   size_t lines_per_charge;
+  Seeding seeding;
   raylib::Color color;
-  std::vector<Line> field_lines{};
-  std::vector<Line> equipotencial_lines{};
-  float zoom;
+
+  // Owned by the render thread
+  Buffer front{};
+  Request staging{};
+  Request submitted{};
+  FrameCache *cache = nullptr;
+  std::unordered_map<size_t, Buffer> cached{};
+  uint64_t cached_generation = 0;
+  /// Cached lines drawn instead of `front`
+  const Buffer *shown = nullptr;
+
+  // Shared, guarded by `mutex`
+  std::mutex mutex{};
+  std::condition_variable_any condition{};
+  Buffer finished{};
+  bool has_finished = false;
+  Request pending{};
+  bool has_pending = false;
+
+  // Owned by the worker thread
+  Buffer back{};
+  Request current{};
+  std::vector<Vector2> trace_buffer{};
+  std::vector<uint8_t> keep_buffer{};
+  std::vector<std::pair<size_t, size_t>> segment_stack{};
+  OccupancyGrid occupancy{};
+  std::vector<Vector2> backward_buffer{};
+  std::vector<raylib::Vector2> seeds{};
+
+  // Declared last, so it's stopped and joined before the rest is destroyed
+  std::jthread worker{};
 };
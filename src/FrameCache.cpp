@@ -0,0 +1,92 @@
+#include "FrameCache.hpp"
+#include "defs.hpp"
+#include <algorithm>
+#include <cmath>
+
+FrameCache::FrameCache(
+    const std::optional<double> period, const size_t memory_limit
+)
+    : memory_limit(memory_limit) {
+  if (!period || *period <= 0.0 || *period > FRAME_CACHE_MAX_PERIOD)
+    return;
+
+  // Whole number of phases, so they line up in every period
+  phases = std::max<size_t>(
+      1, static_cast<size_t>(std::round(*period / FRAME_CACHE_STEP))
+  );
+  step = *period / static_cast<double>(phases);
+}
+
+void FrameCache::validate(
+    const std::span<const Charge> charges,
+    const raylib::Camera2D &camera,
+    const raylib::Vector2 screen_size
+) {
+  staged_signature.clear();
+  staged_signature.insert(
+      staged_signature.end(),
+      {camera.target.x,
+       camera.target.y,
+       camera.offset.x,
+       camera.offset.y,
+       camera.zoom,
+       screen_size.x,
+       screen_size.y}
+  );
+  for (const auto &charge : charges) {
+    const auto position = charge.position();
+    staged_signature.insert(
+        staged_signature.end(), {position.x, position.y, charge.modifier()}
+    );
+  }
+
+  if (staged_signature == signature)
+    return;
+
+  std::swap(signature, staged_signature);
+  heatmaps.clear();
+  memory_used = 0;
+  ++_generation;
+}
+
+std::optional<FrameCache::Key>
+FrameCache::key(const double elapsedTime) const {
+  if (phases == 0)
+    return std::nullopt;
+
+  const auto period = step * static_cast<double>(phases);
+  const auto phase = static_cast<size_t>(
+      std::floor(std::fmod(std::max(elapsedTime, 0.0), period) / step)
+  );
+  return Key{std::min(phase, phases - 1), _generation};
+}
+
+double FrameCache::time(const Key &key) const {
+  return step * static_cast<double>(key.phase);
+}
+
+bool FrameCache::reserve(const size_t bytes) {
+  if (memory_used + bytes > memory_limit)
+    return false;
+
+  memory_used += bytes;
+  return true;
+}
+
+const std::vector<float> *FrameCache::heatmap(const Key &key) const {
+  if (key.generation != _generation)
+    return nullptr;
+
+  const auto it = heatmaps.find(key.phase);
+  return it != heatmaps.end() ? &it->second : nullptr;
+}
+
+void FrameCache::store_heatmap(
+    const Key &key, const std::span<const float> values
+) {
+  if (key.generation != _generation || heatmaps.contains(key.phase) ||
+      !reserve(values.size_bytes()))
+    return;
+
+  heatmaps.emplace(key.phase, std::vector(values.begin(), values.end()));
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Charge.hpp"
+#include <Camera2D.hpp>
+#include <Vector2.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Frames of a periodic scene, cached by their phase
+ *
+ * The period is split into phases of about `FRAME_CACHE_STEP` of simulation
+ * time. Everything cached for a phase is computed at the time of the phase in
+ * the first period, so it stays valid in all later periods, and a scene with
+ * an unchanged view is served from the cache after the first period.
+ *
+ * Moving the view or changing the charges invalidates all entries at once, by
+ * starting a new generation. Entries are only added while they fit into the
+ * memory limit, evicting entries wouldn't help, as the phases are visited in
+ * order and each one would be evicted before it's used again.
+ */
+class FrameCache {
+public:
+  struct Key {
+    size_t phase;
+    uint64_t generation;
+
+    bool operator==(const Key &) const = default;
+  };
+
+  /// @param period Period of the scene, it's only cached if there's one
+  FrameCache(const std::optional<double> period, const size_t memory_limit);
+
+  FrameCache(const FrameCache &) = delete;
+  FrameCache &operator=(const FrameCache &) = delete;
+
+  /// Start a new generation, if the view or the charges changed since the
+  /// last call. Tracked even without a period, other frames computed ahead
+  /// rely on it too.
+  void validate(
+      const std::span<const Charge> charges,
+      const raylib::Camera2D &camera,
+      const raylib::Vector2 screen_size
+  );
+
+  /// Key of the phase of `elapsedTime`, `nullopt` when nothing is cached
+  std::optional<Key> key(const double elapsedTime) const;
+  /// Time in the first period, at which the frames of the phase are computed
+  double time(const Key &key) const;
+  /// Number of phases in a period, 0 when nothing is cached
+  size_t phase_count() const { return phases; }
+  uint64_t generation() const { return _generation; }
+
+  /// Account for an entry of `bytes`, false when it doesn't fit
+  bool reserve(const size_t bytes);
+
+  const std::vector<float> *heatmap(const Key &key) const;
+  void store_heatmap(const Key &key, const std::span<const float> values);
+
+private:
+  size_t phases = 0;
+  double step = 0.0;
+  size_t memory_limit;
+  size_t memory_used = 0;
+  uint64_t _generation = 0;
+
+  /// State of the view and the charges of the current generation
+  std::vector<float> signature{};
+  std::vector<float> staged_signature{};
+
+  std::unordered_map<size_t, std::vector<float>> heatmaps{};
+};
@@ -2,82 +2,103 @@
 #include "Camera2D.hpp"
 #include "Position.hpp"
 #include "Probe.hpp"
+#include "ProbeField.hpp"
 #include <Color.hpp>
 #include <Vector2.hpp>
 #include <algorithm>
-#include <memory>
+#include <array>
+#include <cmath>
 #include <span>
 #include <vector>
 
 void GridLine::draw() const { start.DrawLine(end, color); }
 
-std::vector<GridLine> generateLines(
-    const raylib::Vector2 size,
-    const raylib::Vector2 spacing,
-    const raylib::Color color,
-    const raylib::Camera2D &camera
-) {
-  const auto size_half = size / 2.0f;
-  const auto screen_to_world = [&](const float x, const float y) {
-    return camera.GetScreenToWorld({x, y});
-  };
+void GridLine::draw_to_buffer(ProbeRenderer &renderer) const {
+  renderer.add_line(start, end, color);
+}
 
-  std::vector<GridLine> lines;
+int wrap(const int value, const int size) {
+  return ((value % size) + size) % size;
+}
 
-  for (float y = size_half.y; y <= size.y; y += spacing.y) {
-    lines.emplace_back(
-        screen_to_world(0.f, y), screen_to_world(size.x, y), color
-    );
+size_t Grid::slot(const int column, const int row) const {
+  return static_cast<size_t>(wrap(row, rows) * columns + wrap(column, columns));
+}
+
+void Grid::generate_lines() {
+  lines.clear();
+
+  const auto first_x = static_cast<int>(std::ceil(view.x / world_spacing.x));
+  const auto last_x =
+      static_cast<int>(std::floor((view.x + view.width) / world_spacing.x));
+  const auto first_y = static_cast<int>(std::ceil(view.y / world_spacing.y));
+  const auto last_y =
+      static_cast<int>(std::floor((view.y + view.height) / world_spacing.y));
+
+  for (int row = first_y; row <= last_y; ++row) {
+    auto y = row * world_spacing.y;
     lines.emplace_back(
-        screen_to_world(0.f, size.y - y),
-        screen_to_world(size.x, size.y - y),
-        color
+        raylib::Vector2{view.x, y},
+        raylib::Vector2{view.x + view.width, y},
+        line_color
     );
   }
 
-  for (float x = size_half.x; x <= size.x; x += spacing.x) {
+  for (int column = first_x; column <= last_x; ++column) {
+    auto x = column * world_spacing.x;
     lines.emplace_back(
-        screen_to_world(x, 0.f), screen_to_world(x, size.y), color
-    );
-    lines.emplace_back(
-        screen_to_world(size.x - x, 0.f),
-        screen_to_world(size.x - x, size.y),
-        color
+        raylib::Vector2{x, view.y},
+        raylib::Vector2{x, view.y + view.height},
+        line_color
     );
   }
+}
+
+void Grid::regenerate(const int new_first_column, const int new_first_row) {
+  first_column = new_first_column;
+  first_row = new_first_row;
 
-  return lines;
+  probes.clear();
+  probes.reserve(static_cast<size_t>(columns * rows));
+  probes.length = std::min(world_spacing.x, world_spacing.y);
+  for (size_t level = 0; level < details.size(); ++level) {
+    details[level].length = probes.length / static_cast<float>(2 << level);
+  }
+
+  // Push in storage order, each slot gets the visible lattice point, that
+  // wraps into it
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < columns; ++c) {
+      auto column = first_column + wrap(c - first_column, columns);
+      auto row = first_row + wrap(r - first_row, rows);
+      probes.push_back(
+          position::Static(lattice_point(column, row)), probe_color
+      );
+    }
+  }
 }
 
-std::vector<Probe> generateProbes(
-    const raylib::Vector2 size,
-    const raylib::Vector2 spacing,
-    const raylib::Color color,
-    const raylib::Camera2D &camera
-) {
-  const auto size_half = size / 2.0f;
-  const auto screen_to_world = [&](const Vector2 position) {
-    return camera.GetScreenToWorld(position);
-  };
+void Grid::reproject(const int new_first_column, const int new_first_row) {
+  for (int row = new_first_row; row < new_first_row + rows; ++row) {
+    for (int column = new_first_column; column < new_first_column + columns;
+         ++column) {
+      auto was_visible = column >= first_column &&
+                         column < first_column + columns &&
+                         row >= first_row && row < first_row + rows;
 
-  std::vector<Probe> probes;
-
-  for (float y = 0.f; y <= size_half.y + spacing.y; y += spacing.y) {
-    for (float x = 0.f; x <= size_half.x + spacing.x; x += spacing.x) {
-      for (const auto pos :
-           std::vector<Vector2>{{x, y}, {x, -y}, {-x, y}, {-x, -y}}) {
-        auto position = size_half + pos;
-        probes.emplace_back(
-            std::make_unique<position::Static>(screen_to_world(position)),
-            color,
-            0,
-            std::min(spacing.x, spacing.y) / camera.GetZoom()
+      // Slots of probes, that left the view, are reused for the new ones
+      if (!was_visible) {
+        probes.set(
+            slot(column, row),
+            position::Static(lattice_point(column, row)),
+            probe_color
         );
       }
     }
   }
 
-  return probes;
+  first_column = new_first_column;
+  first_row = new_first_row;
 }
 
 void Grid::resize(
@@ -85,30 +106,182 @@ void Grid::resize(
     const raylib::Vector2 spacing,
     const raylib::Camera2D &camera
 ) {
-  lines = generateLines(size, spacing, line_color, camera);
-  probes = generateProbes(size, spacing, probe_color, camera);
+  const auto top_left = camera.GetScreenToWorld({0.f, 0.f});
+  const auto bottom_right = camera.GetScreenToWorld(size);
+  view = raylib::Rectangle{
+      top_left.x,
+      top_left.y,
+      bottom_right.x - top_left.x,
+      bottom_right.y - top_left.y
+  };
+
+  const auto zoom = camera.GetZoom();
+  const auto layout_changed =
+      size != layout_size || spacing != layout_spacing || zoom != layout_zoom;
+
+  if (layout_changed) {
+    layout_size = size;
+    layout_spacing = spacing;
+    layout_zoom = zoom;
+
+    // Coarsen the lattice until it fits into its share of the budget
+    const auto budget = static_cast<int>(
+        static_cast<float>(PROBE_BUDGET) * (1.f - PROBE_DETAIL_SHARE)
+    );
+    world_spacing = spacing / zoom;
+    while (true) {
+      // Keep one extra lattice line on each side, arrows from outside of the
+      // view reach into it
+      columns = static_cast<int>(std::ceil(view.width / world_spacing.x)) + 3;
+      rows = static_cast<int>(std::ceil(view.height / world_spacing.y)) + 3;
+      if (columns * rows <= budget)
+        break;
+      world_spacing *= 2.f;
+    }
+  }
+
+  const auto new_first_column =
+      static_cast<int>(std::floor(view.x / world_spacing.x)) - 1;
+  const auto new_first_row =
+      static_cast<int>(std::floor(view.y / world_spacing.y)) - 1;
+
+  if (layout_changed) {
+    regenerate(new_first_column, new_first_row);
+  } else if (new_first_column != first_column || new_first_row != first_row) {
+    reproject(new_first_column, new_first_row);
+  }
+
+  generate_lines();
+}
+
+/// Relative variation of the field over the corners of a cell, 0 when it's
+/// uniform
+float variation(const std::array<raylib::Vector2, 4> &samples) {
+  raylib::Vector2 mean{};
+  float magnitudes = 0.f;
+  for (const auto &sample : samples) {
+    mean += sample;
+    magnitudes += sample.Length();
+  }
+  mean /= static_cast<float>(samples.size());
+
+  if (magnitudes == 0.f)
+    return 0.f;
+
+  float deviations = 0.f;
+  for (const auto &sample : samples) {
+    deviations += (sample - mean).Length();
+  }
+
+  return deviations / magnitudes;
 }
 
-void Grid::draw() const {
-  ProbeRenderer renderer{};
+void Grid::refine() {
+  for (auto &detail : details) {
+    detail.clear();
+  }
+
+  cells.clear();
+
+  // Only cells with all corners sampled can be judged
+  for (int row = first_row; row < first_row + rows - 1; ++row) {
+    for (int column = first_column; column < first_column + columns - 1;
+         ++column) {
+      const std::array corners{
+          slot(column, row),
+          slot(column + 1, row),
+          slot(column, row + 1),
+          slot(column + 1, row + 1)
+      };
+
+      if (!std::ranges::all_of(corners, [&](auto i) {
+            return probes.visible(i);
+          }))
+        continue;
+
+      const auto cell_variation = variation({
+          probes.sample(corners[0]),
+          probes.sample(corners[1]),
+          probes.sample(corners[2]),
+          probes.sample(corners[3]),
+      });
 
-  for (auto &probe : probes) {
-    renderer.draw_to_buffer(probe);
+      if (cell_variation > PROBE_REFINE_THRESHOLD) {
+        cells.push_back(
+            {cell_variation, lattice_point(column, row), world_spacing, 0}
+        );
+      }
+    }
   }
 
-  renderer.flush();
+  std::make_heap(cells.begin(), cells.end());
+
+  auto remaining = PROBE_BUDGET - std::min(PROBE_BUDGET, probes.size());
+
+  // Most varying cells first. Each refined cell gets a probe in its center
+  // and is split into quarters. Variation scales with the size of the cell, so
+  // the quarters are expected to vary half as much.
+  while (!cells.empty() && remaining > 0) {
+    std::pop_heap(cells.begin(), cells.end());
+    const auto cell = cells.back();
+    cells.pop_back();
+
+    const auto half = cell.size / 2.f;
+    details[cell.level].push_back(
+        position::Static(cell.corner + half), probe_color
+    );
+    --remaining;
+
+    const auto child_variation = cell.variation / 2.f;
+    if (cell.level + 1 >= PROBE_DETAIL_LEVELS ||
+        child_variation <= PROBE_REFINE_THRESHOLD)
+      continue;
 
-  for (auto &line : lines) {
-    line.draw();
+    for (auto offset : {
+             raylib::Vector2{0.f, 0.f},
+             raylib::Vector2{half.x, 0.f},
+             raylib::Vector2{0.f, half.y},
+             half,
+         }) {
+      cells.push_back(
+          {child_variation, cell.corner + offset, half, cell.level + 1}
+      );
+      std::push_heap(cells.begin(), cells.end());
+    }
   }
 }
 
+void Grid::draw() const { renderer.flush(); }
+
 void Grid::update(
     const float timeDelta,
     const double elapsedTime,
-    const std::span<Charge> &charges
+    const std::span<Charge> &charges,
+    const Symmetry &symmetry
 ) {
-  for (auto &probe : probes) {
-    probe.update(timeDelta, elapsedTime, charges);
+  // Probes just outside of the view have arrows reaching into it
+  const auto margin = std::max(world_spacing.x, world_spacing.y);
+  const raylib::Rectangle bounds{
+      view.x - margin,
+      view.y - margin,
+      view.width + 2 * margin,
+      view.height + 2 * margin
+  };
+
+  sources.assign(charges, elapsedTime);
+  if (probes.update(timeDelta, elapsedTime, sources, bounds, symmetry))
+    refine();
+
+  for (auto &detail : details) {
+    detail.update(timeDelta, elapsedTime, sources, bounds, symmetry);
+  }
+
+  renderer.clear();
+  renderer.draw_to_buffer(probes);
+  for (const auto &detail : details) {
+    renderer.draw_to_buffer(detail);
+  }
+  for (const auto &line : lines) {
+    line.draw_to_buffer(renderer);
   }
 }
@@ -1,9 +1,15 @@
 #pragma once
 #include "Charge.hpp"
 #include "Probe.hpp"
+#include "ProbeField.hpp"
+#include "Symmetry.hpp"
+#include "defs.hpp"
+#include "field.hpp"
 #include <Camera2D.hpp>
 #include <Color.hpp>
+#include <Rectangle.hpp>
 #include <Vector2.hpp>
+#include <array>
 #include <format>
 #include <vector>
 
@@ -16,6 +22,7 @@ public:
   )
       : start(start), end(end), color(color) {}
   void draw() const;
+  void draw_to_buffer(ProbeRenderer &renderer) const;
 
 private:
   raylib::Vector2 start;
@@ -41,6 +48,14 @@ template <> struct std::formatter<GridLine> {
   }
 };
 
+/**
+ * @brief Probes on a lattice covering the view, with grid lines along it
+ *
+ * The number of probes is kept within `PROBE_BUDGET`. When the lattice given
+ * by the spacing doesn't fit into the budget, its spacing is doubled until it
+ * does. The rest of the budget goes to detail probes, placed hierarchically in
+ * the lattice cells, where the field changes the most.
+ */
 class Grid {
 public:
   Grid(
@@ -55,11 +70,20 @@ public:
   }
 
   void draw() const;
+  /// Probes are evaluated once for each orbit of the `symmetry`
   void update(
       const float timeDelta,
       const double elapsedTime,
-      const std::span<Charge> &charges
+      const std::span<Charge> &charges,
+      const Symmetry &symmetry
   );
+  /**
+   * @brief Fit the grid to the view of the camera
+   *
+   * The grid is anchored in the world, so when only the camera target changed
+   * just the rows and columns that entered the view are replaced. Everything
+   * is regenerated only when the size, spacing or zoom changes.
+   */
   void resize(
       const raylib::Vector2 size,
       const raylib::Vector2 spacing,
@@ -67,9 +91,49 @@ public:
   );
 
 private:
+  void regenerate(const int new_first_column, const int new_first_row);
+  void reproject(const int new_first_column, const int new_first_row);
+  void generate_lines();
+  void refine();
+  size_t slot(const int column, const int row) const;
+  raylib::Vector2 lattice_point(const int column, const int row) const {
+    return {column * world_spacing.x, row * world_spacing.y};
+  }
+
   const raylib::Color line_color;
   const raylib::Color probe_color;
-  raylib::Vector2 origin{0, 0};
   std::vector<GridLine> lines;
-  std::vector<Probe> probes;
+  ProbeField probes;
+  /// Detail probes, each level in cells half the size of the previous one
+  std::array<ProbeField, PROBE_DETAIL_LEVELS> details;
+  field::Sources sources;
+  ProbeRenderer renderer;
+
+  // Layout the probe storage was generated for
+  raylib::Vector2 layout_size{};
+  raylib::Vector2 layout_spacing{};
+  float layout_zoom = 0.f;
+  raylib::Rectangle view{};
+
+  // Probes live on a world-space lattice. Storage wraps around in both
+  // directions, so lattice column `c` always lives in storage column
+  // `c mod columns`, no matter which part of the lattice is visible.
+  raylib::Vector2 world_spacing{};
+  int columns = 0;
+  int rows = 0;
+  int first_column = 0;
+  int first_row = 0;
+
+  struct Cell {
+    float variation;
+    raylib::Vector2 corner;
+    raylib::Vector2 size;
+    int level;
+
+    bool operator<(const Cell &other) const {
+      return variation < other.variation;
+    }
+  };
+  /// Heap of cells to refine, kept to reuse its capacity
+  std::vector<Cell> cells;
 };
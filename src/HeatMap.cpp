@@ -2,19 +2,15 @@
 #include "parallel.hpp"
 #include "utils.hpp"
 
-void HeatMap::update(std::function<float(size_t x, size_t y)> &&pixel_function
-) {
+void HeatMap::update(const std::span<const float> values) {
   auto pixels = std::span(
       static_cast<raylib::Color *>(image.data), image.width * image.height
   );
 
   parallel::for_each<raylib::Color>(
       pixels,
-      [this, &pixel_function](const auto i, auto &pixel) {
-        auto x = i % image.width;
-        auto y = i / image.width;
-        auto value = pixel_function(x, y);
-        pixel = lerpColor3(min_color, mid_color, max_color, value);
+      [this, &values](const auto i, auto &pixel) {
+        pixel = lerpColor3(min_color, mid_color, max_color, values[i]);
       }
   );
 
@@ -1,7 +1,7 @@
 #pragma once
 #include <Image.hpp>
 #include <Texture.hpp>
-#include <functional>
+#include <span>
 
 class HeatMap {
 public:
@@ -22,7 +22,11 @@ public:
         },
         texture{image} {};
 
-  void update(std::function<float(size_t x, size_t y)> &&pixel_function);
+  /// @param values Value in [-1, 1] for each pixel, row by row
+  void update(const std::span<const float> values);
+
+  size_t width() const { return static_cast<size_t>(image.width); }
+  size_t height() const { return static_cast<size_t>(image.height); }
 
   void draw() const;
 
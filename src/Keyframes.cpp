@@ -0,0 +1,199 @@
+#include "Keyframes.hpp"
+#include "defs.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+Keyframes::Keyframes()
+    : worker([this](std::stop_token stop) { run(stop); }) {}
+
+void Keyframes::reset(
+    const uint64_t generation,
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const std::span<const Charge> charges,
+    const double elapsedTime,
+    const float speed
+) {
+  _generation = generation;
+
+  // A keyframe of the previous generation, that's still in progress, gets
+  // dropped once it's finished
+  staging.x.assign(x.begin(), x.end());
+  staging.y.assign(y.begin(), y.end());
+  restart(charges, elapsedTime, speed);
+}
+
+void Keyframes::restart(
+    const std::span<const Charge> charges,
+    const double elapsedTime,
+    const float speed
+) {
+  while (!keyframes.empty()) {
+    unused.push_back(std::move(keyframes.front()));
+    keyframes.pop_front();
+  }
+
+  // The simulation gets `lead` further while the keyframe is computed, and
+  // one more interval before the next one has to be ready
+  const auto lead = compute_time.count() * speed;
+  request(charges, elapsedTime + lead + interval(charges, elapsedTime));
+}
+
+double Keyframes::interval(
+    const std::span<const Charge> charges, const double time
+) const {
+  // Step of the finite difference
+  constexpr double DELTA = 1e-3;
+
+  if (field::background().time_dependent())
+    return KEYFRAME_MIN_INTERVAL;
+
+  float max_strength = 0.f;
+  float max_change = 0.f;
+  for (const auto &charge : charges) {
+    const auto strength = charge.strength_at(time);
+    const auto next_strength = charge.strength_at(time + DELTA);
+    max_strength = std::max(max_strength, std::abs(strength));
+    max_change = std::max(max_change, std::abs(next_strength - strength));
+  }
+
+  if (max_change == 0.f)
+    return KEYFRAME_MAX_INTERVAL;
+
+  // Relative to the strongest charge, so weak charges crossing zero don't
+  // force keyframes in every frame
+  const auto rate = max_change / DELTA / std::max(max_strength, 1e-6f);
+  return std::clamp(
+      KEYFRAME_TOLERANCE / rate, KEYFRAME_MIN_INTERVAL, KEYFRAME_MAX_INTERVAL
+  );
+}
+
+void Keyframes::request(
+    const std::span<const Charge> charges, const double time
+) {
+  staging.sources.assign_at(charges, time);
+  staging.time = time;
+  staging.generation = _generation;
+
+  {
+    std::scoped_lock lock{mutex};
+    std::swap(pending, staging);
+    has_pending = true;
+  }
+  condition.notify_one();
+
+  staging.x.clear();
+  staging.y.clear();
+  in_progress = true;
+}
+
+bool Keyframes::interpolate(
+    const std::span<const Charge> charges,
+    const double elapsedTime,
+    const float speed,
+    const std::span<float> out
+) {
+  Keyframe received{};
+  if (!unused.empty()) {
+    received = std::move(unused.back());
+    unused.pop_back();
+  }
+
+  auto received_generation = _generation;
+  auto has_received = false;
+  {
+    std::scoped_lock lock{mutex};
+    if (has_finished) {
+      std::swap(received, finished);
+      received_generation = finished_generation;
+      compute_time = finished_compute_time;
+      has_finished = false;
+      has_received = true;
+    }
+  }
+
+  if (has_received && received_generation == _generation) {
+    keyframes.push_back(std::move(received));
+    in_progress = false;
+  } else {
+    unused.push_back(std::move(received));
+  }
+
+  // Keep the last keyframe before the current time
+  while (keyframes.size() >= 2 && keyframes[1].time <= elapsedTime) {
+    unused.push_back(std::move(keyframes.front()));
+    keyframes.pop_front();
+  }
+
+  // Stay up to two keyframes ahead, far enough for them to be ready in time.
+  // When the simulation outran all of them, start over after the current time.
+  if (!in_progress && !keyframes.empty() && keyframes.size() < 3) {
+    const auto last = keyframes.back().time;
+
+    if (last <= elapsedTime) {
+      restart(charges, elapsedTime, speed);
+    } else {
+      const auto lead = compute_time.count() * speed;
+      request(
+          charges, std::max(last + interval(charges, last), elapsedTime + lead)
+      );
+    }
+  }
+
+  if (keyframes.size() < 2 || elapsedTime < keyframes[0].time)
+    return false;
+
+  const auto &from = keyframes[0];
+  const auto &to = keyframes[1];
+  const auto t = static_cast<float>(
+      (elapsedTime - from.time) / std::max(to.time - from.time, 1e-9)
+  );
+
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = from.values[i] + (to.values[i] - from.values[i]) * t;
+  }
+
+  return true;
+}
+
+void Keyframes::run(std::stop_token stop) {
+  while (true) {
+    {
+      std::unique_lock lock{mutex};
+      if (!condition.wait(lock, stop, [this] { return has_pending; }))
+        return;
+
+      std::swap(current, pending);
+      has_pending = false;
+    }
+
+    if (!current.x.empty()) {
+      std::swap(pixel_x, current.x);
+      std::swap(pixel_y, current.y);
+      current.x.clear();
+      current.y.clear();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    back.time = current.time;
+    back.values.resize(pixel_x.size());
+    field::potential(pixel_x, pixel_y, current.sources, back.values);
+    for (auto &value : back.values) {
+      value = sigmoid(value);
+    }
+
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    {
+      std::scoped_lock lock{mutex};
+      std::swap(back, finished);
+      finished_generation = current.generation;
+      finished_compute_time = duration;
+      has_finished = true;
+    }
+  }
+}
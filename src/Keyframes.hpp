@@ -0,0 +1,115 @@
+#pragma once
+#include "Charge.hpp"
+#include "field.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Heatmap interpolated between keyframes computed ahead of time
+ *
+ * Full heatmaps are only computed at keyframes, on a background thread and
+ * ahead of the simulation time, frames in between are linearly interpolated
+ * per pixel. Keyframes are spaced by how fast the strengths of the charges
+ * change, so slowly varying scenes need only a few of them. They're requested
+ * at least as far ahead as computing one takes at the simulation `speed`, so
+ * they're ready before the simulation gets to them.
+ *
+ * The pixels have to stay in place and the charges mustn't move, any change
+ * of them needs a `reset`.
+ */
+class Keyframes {
+public:
+  Keyframes();
+
+  Keyframes(const Keyframes &) = delete;
+  Keyframes &operator=(const Keyframes &) = delete;
+
+  /// Drop all keyframes and start again after `elapsedTime`
+  void reset(
+      const uint64_t generation,
+      const std::span<const float> x,
+      const std::span<const float> y,
+      const std::span<const Charge> charges,
+      const double elapsedTime,
+      const float speed
+  );
+
+  /// Generation of the last reset
+  uint64_t generation() const { return _generation; }
+
+  /**
+   * @brief Values of the pixels at `elapsedTime`, in [-1, 1]
+   *
+   * Also requests the next keyframe, when there's none in progress.
+   *
+   * @return False when the keyframes around `elapsedTime` aren't ready yet
+   */
+  bool interpolate(
+      const std::span<const Charge> charges,
+      const double elapsedTime,
+      const float speed,
+      const std::span<float> out
+  );
+
+private:
+  struct Keyframe {
+    double time = 0.0;
+    std::vector<float> values{};
+  };
+
+  struct Request {
+    field::Sources sources{};
+    double time = 0.0;
+    uint64_t generation = 0;
+    /// New positions of the pixels, empty if they didn't change
+    std::vector<float> x{};
+    std::vector<float> y{};
+  };
+
+  double interval(const std::span<const Charge> charges, const double time)
+      const;
+  void request(const std::span<const Charge> charges, const double time);
+  /// Drop all keyframes and request the first one, that can be ready in time
+  void restart(
+      const std::span<const Charge> charges,
+      const double elapsedTime,
+      const float speed
+  );
+
+  void run(std::stop_token stop);
+
+  // Owned by the render thread
+  uint64_t _generation = 0;
+  std::deque<Keyframe> keyframes{};
+  bool in_progress = false;
+  Request staging{};
+  std::vector<Keyframe> unused{};
+  /// Wall time it took to compute the last keyframe
+  std::chrono::duration<double> compute_time{0.0};
+
+  // Shared, guarded by `mutex`
+  std::mutex mutex{};
+  std::condition_variable_any condition{};
+  Request pending{};
+  bool has_pending = false;
+  Keyframe finished{};
+  uint64_t finished_generation = 0;
+  std::chrono::duration<double> finished_compute_time{0.0};
+  bool has_finished = false;
+
+  // Owned by the worker thread
+  Request current{};
+  std::vector<float> pixel_x{};
+  std::vector<float> pixel_y{};
+  Keyframe back{};
+
+  // Declared last, so it's stopped and joined before the rest is destroyed
+  std::jthread worker{};
+};
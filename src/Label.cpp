@@ -0,0 +1,49 @@
+#include "Label.hpp"
+#include <utility>
+
+void TextLayer::clear() {
+  texts.clear();
+  dirty = true;
+}
+
+void TextLayer::add(
+    std::string text,
+    const raylib::Vector2 position,
+    const int font_size,
+    const raylib::Color &color
+) {
+  texts.push_back({std::move(text), position, font_size, color});
+  dirty = true;
+}
+
+void TextLayer::render() {
+  target.BeginMode();
+  ClearBackground(BLANK);
+  for (const auto &[text, position, font_size, color] : texts) {
+    raylib::DrawText(text, position.x, position.y, font_size, color);
+  }
+  target.EndMode();
+
+  dirty = false;
+}
+
+void TextLayer::draw(const raylib::Vector2 size) {
+  if (size != target_size) {
+    target = raylib::RenderTexture2D(
+        static_cast<int>(size.x), static_cast<int>(size.y)
+    );
+    target_size = size;
+    dirty = true;
+  }
+
+  if (dirty)
+    render();
+
+  // Render textures are stored upside down
+  DrawTextureRec(
+      target.texture,
+      {0.f, 0.f, target_size.x, -target_size.y},
+      {0.f, 0.f},
+      WHITE
+  );
+}
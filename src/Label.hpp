@@ -0,0 +1,99 @@
+#pragma once
+#include <Color.hpp>
+#include <Functions.hpp>
+#include <RenderTexture.hpp>
+#include <Vector2.hpp>
+#include <format>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+/**
+ * @brief Formatted text with its measured width
+ *
+ * The text is formatted and measured again only when the values differ from
+ * the previous ones. Floats should be rounded to the displayed precision
+ * first (see `round_significant`), so changes that don't show aren't
+ * formatted either.
+ */
+template <typename... Values> class Label {
+public:
+  Label(const std::format_string<Values...> format, const int font_size)
+      : format(format.get()), font_size(font_size) {}
+
+  void update(const Values &...new_values) {
+    if (formatted && values == std::tie(new_values...))
+      return;
+
+    values = {new_values...};
+    formatted = true;
+    _text = std::vformat(format, std::make_format_args(new_values...));
+    _width = raylib::MeasureText(_text, font_size);
+  }
+
+  const std::string &text() const { return _text; }
+  int width() const { return _width; }
+
+  void draw(const float x, const float y, const raylib::Color &color) const {
+    raylib::DrawText(_text, x, y, font_size, color);
+  }
+
+  /// Draw centered horizontally at `position`
+  void draw_centered(
+      const raylib::Vector2 position, const raylib::Color &color
+  ) const {
+    draw(position.x - _width / 2.f, position.y, color);
+  }
+
+private:
+  std::string_view format;
+  int font_size;
+
+  std::tuple<Values...> values{};
+  bool formatted = false;
+  std::string _text{};
+  int _width = 0;
+};
+
+/**
+ * @brief Texts that don't change between frames
+ *
+ * All texts are rendered into a texture once and then drawn as a single
+ * quad, until they are changed or the layer is resized.
+ */
+class TextLayer {
+public:
+  TextLayer() = default;
+
+  TextLayer(const TextLayer &) = delete;
+  TextLayer &operator=(const TextLayer &) = delete;
+
+  /// Remove all texts
+  void clear();
+
+  void add(
+      std::string text,
+      const raylib::Vector2 position,
+      const int font_size,
+      const raylib::Color &color
+  );
+
+  /// Draw the texts, rendering them first if they changed
+  void draw(const raylib::Vector2 size);
+
+private:
+  struct Text {
+    std::string text;
+    raylib::Vector2 position;
+    int font_size;
+    raylib::Color color;
+  };
+
+  void render();
+
+  std::vector<Text> texts{};
+  raylib::RenderTexture2D target{};
+  raylib::Vector2 target_size{};
+  bool dirty = true;
+};
@@ -0,0 +1,266 @@
+#include "MappedFile.hpp"
+#include <cstdint>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// Mappings have to start at a multiple of this
+size_t granularity() {
+#ifdef _WIN32
+  SYSTEM_INFO info{};
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+#else
+  return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) {
+  auto *file = CreateFileA(
+      path.c_str(),
+      GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ,
+      nullptr,
+      CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      nullptr
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    set_error();
+    return;
+  }
+
+  handle = file;
+}
+
+bool MappedFile::is_open() const { return handle != nullptr; }
+
+bool MappedFile::reserve(const size_t new_size) {
+  // Extending a file that isn't sparse allocates the clusters right away
+  return new_size <= size || truncate(new_size);
+}
+
+bool MappedFile::truncate(const size_t new_size) {
+  LARGE_INTEGER end{};
+  end.QuadPart = static_cast<LONGLONG>(new_size);
+  if (!SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) ||
+      !SetEndOfFile(handle)) {
+    set_error();
+    return false;
+  }
+
+  size = new_size;
+  return true;
+}
+
+bool MappedFile::write(
+    const size_t offset, const void *data, const size_t bytes
+) {
+  const auto start = static_cast<uint64_t>(offset);
+  OVERLAPPED position{};
+  position.Offset = static_cast<DWORD>(start);
+  position.OffsetHigh = static_cast<DWORD>(start >> 32);
+
+  DWORD written = 0;
+  if (!WriteFile(
+          handle, data, static_cast<DWORD>(bytes), &written, &position
+      ) ||
+      written != bytes) {
+    set_error();
+    return false;
+  }
+  return true;
+}
+
+std::byte *MappedFile::map(const size_t offset, const size_t bytes) {
+  unmap();
+
+  const auto start = offset - offset % granularity();
+
+  // The view keeps the mapping alive, so its handle isn't needed afterwards
+  auto *mapping =
+      CreateFileMappingA(handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    set_error();
+    return nullptr;
+  }
+
+  view = MapViewOfFile(
+      mapping,
+      FILE_MAP_WRITE,
+      static_cast<DWORD>(static_cast<uint64_t>(start) >> 32),
+      static_cast<DWORD>(static_cast<uint64_t>(start)),
+      bytes + (offset - start)
+  );
+  if (view == nullptr)
+    set_error();
+  CloseHandle(mapping);
+
+  if (view == nullptr)
+    return nullptr;
+
+  view_size = bytes + (offset - start);
+  return static_cast<std::byte *>(view) + (offset - start);
+}
+
+void MappedFile::unmap() {
+  if (view == nullptr)
+    return;
+
+  UnmapViewOfFile(view);
+  view = nullptr;
+  view_size = 0;
+}
+
+void MappedFile::close() {
+  if (!is_open())
+    return;
+
+  unmap();
+  CloseHandle(handle);
+  handle = nullptr;
+}
+
+void MappedFile::set_error() {
+  char message[256] = {};
+  const auto length = FormatMessageA(
+      FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+      nullptr,
+      GetLastError(),
+      0,
+      message,
+      sizeof(message),
+      nullptr
+  );
+
+  _error.assign(message, length);
+  // The messages end with a line break
+  while (!_error.empty() && (_error.back() == '\n' || _error.back() == '\r'))
+    _error.pop_back();
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    set_error();
+}
+
+bool MappedFile::is_open() const { return fd >= 0; }
+
+bool MappedFile::reserve(const size_t new_size) {
+  if (new_size <= size)
+    return true;
+
+#ifdef __APPLE__
+  // There's no posix_fallocate, the space is allocated past the physical end
+  // of the file, contiguous if possible, and then the file is extended over it
+  fstore_t store{};
+  store.fst_flags = F_ALLOCATECONTIG;
+  store.fst_posmode = F_PEOFPOSMODE;
+  store.fst_length = static_cast<off_t>(new_size - size);
+  if (::fcntl(fd, F_PREALLOCATE, &store) == -1) {
+    store.fst_flags = F_ALLOCATEALL;
+    if (::fcntl(fd, F_PREALLOCATE, &store) == -1) {
+      set_error();
+      return false;
+    }
+  }
+
+  return truncate(new_size);
+#else
+  // It returns the error instead of setting `errno`
+  const auto error = ::posix_fallocate(fd, 0, static_cast<off_t>(new_size));
+  if (error != 0) {
+    errno = error;
+    set_error();
+    return false;
+  }
+
+  size = new_size;
+  return true;
+#endif
+}
+
+bool MappedFile::truncate(const size_t new_size) {
+  if (::ftruncate(fd, static_cast<off_t>(new_size)) != 0) {
+    set_error();
+    return false;
+  }
+
+  size = new_size;
+  return true;
+}
+
+bool MappedFile::write(
+    const size_t offset, const void *data, const size_t bytes
+) {
+  if (::pwrite(fd, data, bytes, static_cast<off_t>(offset)) !=
+      static_cast<ssize_t>(bytes)) {
+    set_error();
+    return false;
+  }
+  return true;
+}
+
+std::byte *MappedFile::map(const size_t offset, const size_t bytes) {
+  unmap();
+
+  const auto start = offset - offset % granularity();
+  auto *mapping = ::mmap(
+      nullptr,
+      bytes + (offset - start),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      static_cast<off_t>(start)
+  );
+  if (mapping == MAP_FAILED) {
+    set_error();
+    return nullptr;
+  }
+
+  view = mapping;
+  view_size = bytes + (offset - start);
+  return static_cast<std::byte *>(view) + (offset - start);
+}
+
+void MappedFile::unmap() {
+  if (view == nullptr)
+    return;
+
+  ::munmap(view, view_size);
+  view = nullptr;
+  view_size = 0;
+}
+
+void MappedFile::close() {
+  if (!is_open())
+    return;
+
+  unmap();
+  ::close(fd);
+  fd = -1;
+}
+
+void MappedFile::set_error() { _error = std::strerror(errno); }
+
+#endif
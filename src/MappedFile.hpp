@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief File written through a single mapped window, over the API of the
+ * platform
+ *
+ * All operations report failures by their result, `error` then describes the
+ * last one. The file is created empty, or truncated when it exists.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool is_open() const;
+
+  /// Grow the file to `new_size` bytes, with the space allocated on the disk,
+  /// so writes into a mapping of it can't fail later
+  bool reserve(const size_t new_size);
+  /// Shrink or grow the file to exactly `new_size` bytes, nothing may be
+  /// mapped
+  bool truncate(const size_t new_size);
+  bool write(const size_t offset, const void *data, const size_t bytes);
+
+  /**
+   * @brief Map `bytes` bytes starting at `offset` for writing
+   *
+   * The bytes have to be within the file. Replaces the previous mapping.
+   *
+   * @return Start of the mapped bytes, `nullptr` when mapping failed
+   */
+  std::byte *map(const size_t offset, const size_t bytes);
+  void unmap();
+
+  void close();
+
+  /// Description of the last failure
+  const std::string &error() const { return _error; }
+
+private:
+  /// Remember the error of the last call into the platform
+  void set_error();
+
+#ifdef _WIN32
+  void *handle = nullptr;
+#else
+  int fd = -1;
+#endif
+  size_t size = 0;
+
+  // Whole mapping, it starts at an allocation boundary before the offset
+  void *view = nullptr;
+  size_t view_size = 0;
+
+  std::string _error{};
+};
@@ -1,26 +1,55 @@
 #include "MathEval.hpp"
+#include "FastMath.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <deque>
-#include <functional>
+#include <numbers>
+#include <optional>
 #include <stack>
 
 namespace math {
 
-const std::unordered_map<std::string, std::function<float(float)>> functions = {
-    {"sin", [](float x) { return std::sin(x); }},
-    {"cos", [](float x) { return std::cos(x); }},
-    {"tan", [](float x) { return std::tan(x); }},
-    {"asin", [](float x) { return std::asin(x); }},
-    {"acos", [](float x) { return std::acos(x); }},
-    {"atan", [](float x) { return std::atan(x); }},
-    {"sqrt", [](float x) { return std::sqrt(x); }},
-    {"exp", [](float x) { return std::exp(x); }},
-    {"log", [](float x) { return std::log(x); }},
-    {"abs", [](float x) { return std::abs(x); }},
-    {"ceil", [](float x) { return std::ceil(x); }},
-    {"floor", [](float x) { return std::floor(x); }},
-    {"sign", [](float x) { return std::signbit(x) ? -1.f : 1.f; }},
+/// Applies a scalar function to every value, for functions without a vectorized
+/// implementation
+template <float (*F)(float)> void map(const std::span<float> values) {
+  for (auto &value : values) {
+    value = F(value);
+  }
+}
+
+float sin(float x) { return std::sin(x); }
+float cos(float x) { return std::cos(x); }
+float tan(float x) { return std::tan(x); }
+float asin(float x) { return std::asin(x); }
+float acos(float x) { return std::acos(x); }
+float atan(float x) { return std::atan(x); }
+float sqrt(float x) { return std::sqrt(x); }
+float exp(float x) { return std::exp(x); }
+float log(float x) { return std::log(x); }
+float abs(float x) { return std::abs(x); }
+float ceil(float x) { return std::ceil(x); }
+float floor(float x) { return std::floor(x); }
+float sign(float x) { return std::signbit(x) ? -1.f : 1.f; }
+
+// Scalar evaluation keeps the exact `std::` functions, batches use the
+// polynomial approximations
+const std::unordered_map<std::string, Function> functions = {
+    {"sin", {sin, map<fast::sin>, 2.0 * std::numbers::pi}},
+    {"cos", {cos, map<fast::cos>, 2.0 * std::numbers::pi}},
+    {"tan", {tan, map<fast::tan>, std::numbers::pi}},
+    {"asin", {asin, map<asin>}},
+    {"acos", {acos, map<acos>}},
+    {"atan", {atan, map<atan>}},
+    {"sqrt", {sqrt, map<sqrt>}},
+    {"exp", {exp, map<fast::exp>}},
+    {"log", {log, map<fast::log>}},
+    {"abs", {abs, map<abs>}},
+    {"ceil", {ceil, map<ceil>}},
+    {"floor", {floor, map<floor>}},
+    {"sign", {sign, map<sign>}},
 };
 
 bool is_letter(char c) {
@@ -95,7 +124,7 @@ load_brackets(const std::string &input, std::string::const_iterator &it) {
 
 std::deque<Token> parse_to_RPN(
     const std::string_view input,
-    const std::unordered_map<std::string, float> &vars
+    const std::unordered_map<std::string, Token> &vars
 ) {
   std::deque<Token> rpn_queue{};
   std::stack<Operator> op_stack{};
@@ -271,6 +300,8 @@ auto evaluate_RPN(const std::deque<Token> &postfix) {
           using T = std::decay_t<decltype(token)>;
           if constexpr (std::is_same_v<T, float>) {
             stack.push(token);
+          } else if constexpr (std::is_same_v<T, Variable>) {
+            throw parser_exception("Variables are only allowed in programs");
           } else if constexpr (std::is_same_v<T, Operator>) {
             switch (token.type) {
             case OperatorType::Binary: {
@@ -304,7 +335,7 @@ auto evaluate_RPN(const std::deque<Token> &postfix) {
 
               auto n = stack.top();
               stack.pop();
-              stack.push(function->second(n));
+              stack.push(function->second.scalar(n));
             }; break;
             }
           } else {
@@ -321,6 +352,645 @@ auto evaluate_RPN(const std::deque<Token> &postfix) {
   return stack.top();
 }
 
+OpCode binary_op_code(const char ch) {
+  switch (ch) {
+  case '+':
+    return OpCode::Add;
+  case '-':
+    return OpCode::Subtract;
+  case '*':
+    return OpCode::Multiply;
+  case '/':
+    return OpCode::Divide;
+  case '^':
+    return OpCode::Power;
+  case '%':
+    return OpCode::Modulo;
+  default:
+    throw parser_exception(std::format("Unknown operator '{}'", ch));
+  }
+}
+
+float apply(const OpCode op, const float a, const float b) {
+  switch (op) {
+  case OpCode::Add:
+    return a + b;
+  case OpCode::Subtract:
+    return a - b;
+  case OpCode::Multiply:
+    return a * b;
+  case OpCode::Divide:
+    return a / b;
+  case OpCode::Power:
+    return std::pow(a, b);
+  case OpCode::Modulo:
+    return std::fmod(a, b);
+  default:
+    throw parser_exception("Invalid expression");
+  }
+}
+
+bool Compiler::Node::operator==(const Node &other) const {
+  // Constants are compared bitwise, so `0` and `-0` stay distinct
+  return op == other.op &&
+         std::bit_cast<uint32_t>(constant) ==
+             std::bit_cast<uint32_t>(other.constant) &&
+         slot == other.slot && function == other.function &&
+         left == other.left && right == other.right;
+}
+
+size_t Compiler::NodeHash::operator()(const Node &node) const {
+  size_t hash = static_cast<size_t>(node.op);
+  auto combine = [&hash](const size_t value) {
+    hash = hash * 1000003 ^ value;
+  };
+
+  combine(std::bit_cast<uint32_t>(node.constant));
+  combine(node.slot);
+  combine(reinterpret_cast<size_t>(node.function));
+  combine(node.left);
+  combine(node.right);
+  return hash;
+}
+
+Compiler::Compiler(const std::span<const std::string> names) {
+  vars = {
+      {"pi", std::numbers::pi_v<float>},
+      {"e", std::numbers::e_v<float>},
+  };
+  for (size_t slot = 0; slot < names.size(); ++slot) {
+    vars.insert_or_assign(names[slot], Variable{slot});
+  }
+}
+
+uint32_t Compiler::intern(const Node &node) {
+  const auto [it, inserted] =
+      interned.try_emplace(node, static_cast<uint32_t>(nodes.size()));
+  if (inserted)
+    nodes.push_back(node);
+  return it->second;
+}
+
+uint32_t Compiler::constant(const float value) {
+  Node node{OpCode::Constant};
+  node.constant = value;
+  return intern(node);
+}
+
+bool Compiler::is_constant(const uint32_t node, const float value) const {
+  return nodes[node].op == OpCode::Constant && nodes[node].constant == value;
+}
+
+uint32_t Compiler::binary(const OpCode op, uint32_t left, uint32_t right) {
+  if (nodes[left].op == OpCode::Constant && nodes[right].op == OpCode::Constant)
+    return constant(apply(op, nodes[left].constant, nodes[right].constant));
+
+  // Operands of commutative operators are ordered, so `a + b` and `b + a`
+  // end up as the same node
+  if ((op == OpCode::Add || op == OpCode::Multiply) && left > right)
+    std::swap(left, right);
+
+  switch (op) {
+  case OpCode::Add:
+    if (is_constant(left, 0.f))
+      return right;
+    if (is_constant(right, 0.f))
+      return left;
+    break;
+  case OpCode::Subtract:
+    if (is_constant(right, 0.f))
+      return left;
+    if (left == right)
+      return constant(0.f);
+    break;
+  case OpCode::Multiply:
+    if (is_constant(left, 1.f))
+      return right;
+    if (is_constant(right, 1.f))
+      return left;
+    // Like with fast math, infinities and NaNs aren't preserved here
+    if (is_constant(left, 0.f) || is_constant(right, 0.f))
+      return constant(0.f);
+    break;
+  case OpCode::Divide:
+    if (is_constant(right, 1.f))
+      return left;
+    break;
+  case OpCode::Power:
+    if (is_constant(right, 0.f))
+      return constant(1.f);
+    if (is_constant(right, 1.f))
+      return left;
+    if (is_constant(right, 2.f))
+      return binary(OpCode::Multiply, left, left);
+    break;
+  default:
+    break;
+  }
+
+  Node node{op};
+  node.left = left;
+  node.right = right;
+  return intern(node);
+}
+
+uint32_t Compiler::call(const Function *function, const uint32_t argument) {
+  if (nodes[argument].op == OpCode::Constant)
+    return constant(function->scalar(nodes[argument].constant));
+
+  Node node{OpCode::Call};
+  node.function = function;
+  node.left = argument;
+  return intern(node);
+}
+
+size_t Compiler::add(const std::string &expr) {
+  std::string_view trimmedInput = trim(expr);
+
+  if (trimmedInput.empty())
+    throw parser_exception("No input");
+
+  const auto rpn = parse_to_RPN(trimmedInput, vars);
+
+  // Nodes of the operands, that weren't consumed yet
+  std::vector<uint32_t> stack{};
+
+  for (const auto &token : rpn) {
+    if (const auto *number = std::get_if<float>(&token)) {
+      stack.push_back(constant(*number));
+    } else if (const auto *variable = std::get_if<Variable>(&token)) {
+      Node node{OpCode::Variable};
+      node.slot = static_cast<uint32_t>(variable->slot);
+      stack.push_back(intern(node));
+    } else {
+      const auto &op = std::get<Operator>(token);
+      switch (op.type) {
+      case OperatorType::Binary: {
+        if (stack.size() < 2)
+          throw parser_exception("Invalid expression");
+        const auto right = stack.back();
+        stack.pop_back();
+        const auto left = stack.back();
+        stack.back() =
+            binary(binary_op_code(std::get<char>(op.value)), left, right);
+      }; break;
+      case OperatorType::Function: {
+        const auto &function_name = std::get<std::string>(op.value);
+        const auto function = functions.find(function_name);
+
+        if (function == functions.end())
+          throw parser_exception(
+              std::format("Unknown function '{}'", function_name)
+          );
+        if (stack.empty())
+          throw parser_exception("Invalid expression");
+
+        stack.back() = call(&function->second, stack.back());
+      }; break;
+      }
+    }
+  }
+
+  if (stack.size() != 1)
+    throw parser_exception("Invalid expression");
+
+  // Equal expressions share their output
+  const auto root = stack.back();
+  if (const auto it = std::ranges::find(roots, root); it != roots.end())
+    return static_cast<size_t>(std::distance(roots.begin(), it));
+
+  roots.push_back(root);
+  return roots.size() - 1;
+}
+
+/// Emits the instructions of the nodes in postorder, keeping the values of
+/// shared nodes in registers
+struct Compiler::Emitter {
+  const Compiler &compiler;
+  std::vector<Instruction> &code;
+  /// Parents of each node, that are emitted
+  std::vector<uint32_t> uses;
+  /// Register with the value of each node, if it was stored
+  std::vector<std::optional<uint32_t>> registers;
+  uint32_t next_register = 0;
+  size_t depth = 0;
+
+  void push(const Instruction &instruction) {
+    if (++depth > Program::MAX_STACK)
+      throw parser_exception("Expression too complex");
+    code.push_back(instruction);
+  }
+
+  void emit(const uint32_t index) {
+    Instruction instruction{};
+
+    if (const auto slot = registers[index]) {
+      instruction.op = OpCode::Load;
+      instruction.slot = *slot;
+      push(instruction);
+      return;
+    }
+
+    const auto &node = compiler.nodes[index];
+    instruction.op = node.op;
+
+    switch (node.op) {
+    case OpCode::Constant:
+      instruction.constant = node.constant;
+      push(instruction);
+      break;
+    case OpCode::Variable:
+      instruction.slot = node.slot;
+      push(instruction);
+      break;
+    case OpCode::Call:
+      emit(node.left);
+      instruction.function = node.function;
+      code.push_back(instruction);
+      break;
+    default:
+      emit(node.left);
+      if (node.right == node.left) {
+        Instruction duplicate{};
+        duplicate.op = OpCode::Duplicate;
+        push(duplicate);
+      } else {
+        emit(node.right);
+      }
+      --depth;
+      code.push_back(instruction);
+      break;
+    }
+
+    if (uses[index] > 1 && next_register < Program::MAX_REGISTERS) {
+      Instruction store{};
+      store.op = OpCode::Store;
+      store.slot = next_register;
+      code.push_back(store);
+      registers[index] = next_register++;
+    }
+  }
+};
+
+Program Compiler::build() const {
+  Program program{};
+  Emitter emitter{
+      *this,
+      program.code,
+      std::vector<uint32_t>(nodes.size()),
+      std::vector<std::optional<uint32_t>>(nodes.size()),
+  };
+
+  // Operands always precede their parents, so walking backwards visits every
+  // parent before its operands
+  std::vector<bool> reachable(nodes.size());
+  for (const auto root : roots) {
+    reachable[root] = true;
+    ++emitter.uses[root];
+  }
+
+  for (size_t i = nodes.size(); i-- > 0;) {
+    if (!reachable[i])
+      continue;
+
+    const auto &node = nodes[i];
+    switch (node.op) {
+    case OpCode::Constant:
+    case OpCode::Variable:
+      break;
+    case OpCode::Call:
+      reachable[node.left] = true;
+      ++emitter.uses[node.left];
+      break;
+    default:
+      reachable[node.left] = true;
+      reachable[node.right] = true;
+      ++emitter.uses[node.left];
+      if (node.right != node.left)
+        ++emitter.uses[node.right];
+      break;
+    }
+  }
+
+  for (size_t output = 0; output < roots.size(); ++output) {
+    emitter.emit(roots[output]);
+
+    Instruction instruction{};
+    instruction.op = OpCode::Output;
+    instruction.slot = static_cast<uint32_t>(output);
+    program.code.push_back(instruction);
+    --emitter.depth;
+  }
+
+  program.output_count = roots.size();
+  return program;
+}
+
+std::optional<double> common_period(const double a, const double b) {
+  // Largest multiple of a period tried, and relative tolerance of a match
+  constexpr int MAX_MULTIPLE = 64;
+  constexpr double TOLERANCE = 1e-4;
+
+  if (a == 0.0)
+    return b;
+  if (b == 0.0)
+    return a;
+
+  for (int multiple = 1; multiple <= MAX_MULTIPLE; ++multiple) {
+    const auto candidate = a * multiple;
+    const auto other_multiple = std::round(candidate / b);
+    if (other_multiple >= 1.0 &&
+        std::abs(candidate - b * other_multiple) <= TOLERANCE * candidate)
+      return candidate;
+  }
+
+  return std::nullopt;
+}
+
+namespace {
+
+/// How a node depends on the analyzed variable
+struct Dependence {
+  enum class Kind {
+    Invariant,
+    Linear,
+    Periodic,
+    Other,
+  };
+
+  Kind kind;
+  /// Slope when `Linear`, period when `Periodic`
+  double value = 0.0;
+  /// Known value of an `Invariant`
+  std::optional<double> constant = std::nullopt;
+
+  bool is(const Kind other) const { return kind == other; }
+  /// Periodic with any period, constants included
+  bool repeats() const {
+    return kind == Kind::Invariant || kind == Kind::Periodic;
+  }
+  double period() const { return kind == Kind::Periodic ? value : 0.0; }
+};
+
+Dependence combine(const Dependence &left, const Dependence &right) {
+  using enum Dependence::Kind;
+
+  if (!left.repeats() || !right.repeats())
+    return {Other};
+  if (left.is(Invariant) && right.is(Invariant))
+    return {Invariant};
+
+  const auto period = common_period(left.period(), right.period());
+  return period ? Dependence{Periodic, *period} : Dependence{Other};
+}
+
+Dependence linear(const double slope) {
+  using enum Dependence::Kind;
+  return slope == 0.0 ? Dependence{Invariant} : Dependence{Linear, slope};
+}
+
+} // namespace
+
+std::optional<double>
+Compiler::period(const size_t output, const size_t slot) const {
+  using enum Dependence::Kind;
+
+  const auto root = roots[output];
+
+  // Operands always precede their parents, so a single pass is enough
+  std::vector<Dependence> dependences{};
+  dependences.reserve(root + 1);
+
+  // Operands of nodes without any
+  const Dependence none{Other};
+
+  for (size_t i = 0; i <= root; ++i) {
+    const auto &node = nodes[i];
+    const auto &left = node.left < i ? dependences[node.left] : none;
+    const auto &right = node.right < i ? dependences[node.right] : none;
+
+    auto known = [](const Dependence &dependence) {
+      return dependence.is(Invariant) && dependence.constant.has_value() &&
+             *dependence.constant != 0.0;
+    };
+
+    Dependence result{Other};
+
+    switch (node.op) {
+    case OpCode::Constant:
+      result = {Invariant, 0.0, node.constant};
+      break;
+    case OpCode::Variable:
+      result = node.slot == slot ? Dependence{Linear, 1.0}
+                                 : Dependence{Invariant};
+      break;
+    case OpCode::Add:
+    case OpCode::Subtract: {
+      const auto sign = node.op == OpCode::Add ? 1.0 : -1.0;
+      if (left.is(Linear) && right.is(Linear))
+        result = linear(left.value + sign * right.value);
+      else if (left.is(Linear) && right.is(Invariant))
+        result = left;
+      else if (left.is(Invariant) && right.is(Linear))
+        result = linear(sign * right.value);
+      else
+        result = combine(left, right);
+    }; break;
+    case OpCode::Multiply:
+      if (left.is(Linear) && known(right))
+        result = linear(left.value * *right.constant);
+      else if (known(left) && right.is(Linear))
+        result = linear(*left.constant * right.value);
+      else
+        result = combine(left, right);
+      break;
+    case OpCode::Divide:
+      if (left.is(Linear) && known(right))
+        result = linear(left.value / *right.constant);
+      else
+        result = combine(left, right);
+      break;
+    case OpCode::Modulo:
+      if (left.is(Linear) && known(right))
+        result = {Periodic, std::abs(*right.constant / left.value)};
+      else
+        result = combine(left, right);
+      break;
+    case OpCode::Power:
+      result = combine(left, right);
+      break;
+    case OpCode::Call:
+      if (left.repeats())
+        result = {left.kind, left.value};
+      else if (left.is(Linear) && node.function->period > 0.0)
+        result = {Periodic, node.function->period / std::abs(left.value)};
+      break;
+    default:
+      break;
+    }
+
+    dependences.push_back(result);
+  }
+
+  const auto &dependence = dependences[root];
+  if (!dependence.repeats())
+    return std::nullopt;
+  return dependence.period();
+}
+
+Program
+compile(const std::string &expr, const std::span<const std::string> names) {
+  Compiler compiler{names};
+  compiler.add(expr);
+  return compiler.build();
+}
+
+float Program::operator()(const std::span<const float> variables) const {
+  std::array<float, 1> output{};
+  run(variables, output);
+  return output[0];
+}
+
+void Program::run(
+    const std::span<const float> variables, const std::span<float> outputs
+) const {
+  std::array<float, MAX_STACK> stack;
+  std::array<float, MAX_REGISTERS> registers;
+  size_t top = 0;
+
+  for (const auto &instruction : code) {
+    switch (instruction.op) {
+    case OpCode::Constant:
+      stack[top++] = instruction.constant;
+      break;
+    case OpCode::Variable:
+      stack[top++] = variables[instruction.slot];
+      break;
+    case OpCode::Add:
+      --top;
+      stack[top - 1] += stack[top];
+      break;
+    case OpCode::Subtract:
+      --top;
+      stack[top - 1] -= stack[top];
+      break;
+    case OpCode::Multiply:
+      --top;
+      stack[top - 1] *= stack[top];
+      break;
+    case OpCode::Divide:
+      --top;
+      stack[top - 1] /= stack[top];
+      break;
+    case OpCode::Power:
+      --top;
+      stack[top - 1] = std::pow(stack[top - 1], stack[top]);
+      break;
+    case OpCode::Modulo:
+      --top;
+      stack[top - 1] = std::fmod(stack[top - 1], stack[top]);
+      break;
+    case OpCode::Call:
+      stack[top - 1] = instruction.function->scalar(stack[top - 1]);
+      break;
+    case OpCode::Duplicate:
+      stack[top] = stack[top - 1];
+      ++top;
+      break;
+    case OpCode::Load:
+      stack[top++] = registers[instruction.slot];
+      break;
+    case OpCode::Store:
+      registers[instruction.slot] = stack[top - 1];
+      break;
+    case OpCode::Output:
+      --top;
+      // Callers may only want the first few outputs
+      if (instruction.slot < outputs.size())
+        outputs[instruction.slot] = stack[top];
+      break;
+    }
+  }
+}
+
+void Program::run(
+    const size_t count,
+    const std::span<const float> variables,
+    const std::span<float> outputs
+) const {
+  using Lane = std::array<float, LANES>;
+
+  std::array<Lane, MAX_STACK> stack;
+  std::array<Lane, MAX_REGISTERS> registers;
+
+  auto binary = [&stack](size_t &top, auto op) {
+    --top;
+    auto &left = stack[top - 1];
+    const auto &right = stack[top];
+    for (size_t i = 0; i < LANES; ++i) {
+      left[i] = op(left[i], right[i]);
+    }
+  };
+
+  for (size_t start = 0; start < count; start += LANES) {
+    const auto width = std::min(LANES, count - start);
+    size_t top = 0;
+
+    for (const auto &instruction : code) {
+      switch (instruction.op) {
+      case OpCode::Constant:
+        stack[top++].fill(instruction.constant);
+        break;
+      case OpCode::Variable: {
+        auto &lane = stack[top++];
+        const auto values =
+            variables.subspan(instruction.slot * count + start, width);
+        std::ranges::copy(values, lane.begin());
+        // Unused lanes of the last batch get a valid value too
+        std::fill(lane.begin() + width, lane.end(), values[0]);
+      }; break;
+      case OpCode::Add:
+        binary(top, [](float a, float b) { return a + b; });
+        break;
+      case OpCode::Subtract:
+        binary(top, [](float a, float b) { return a - b; });
+        break;
+      case OpCode::Multiply:
+        binary(top, [](float a, float b) { return a * b; });
+        break;
+      case OpCode::Divide:
+        binary(top, [](float a, float b) { return a / b; });
+        break;
+      case OpCode::Power:
+        binary(top, [](float a, float b) { return fast::pow(a, b); });
+        break;
+      case OpCode::Modulo:
+        binary(top, [](float a, float b) { return std::fmod(a, b); });
+        break;
+      case OpCode::Call:
+        instruction.function->batch(stack[top - 1]);
+        break;
+      case OpCode::Duplicate:
+        stack[top] = stack[top - 1];
+        ++top;
+        break;
+      case OpCode::Load:
+        stack[top++] = registers[instruction.slot];
+        break;
+      case OpCode::Store:
+        registers[instruction.slot] = stack[top - 1];
+        break;
+      case OpCode::Output: {
+        --top;
+        const auto offset = instruction.slot * count + start;
+        if (offset < outputs.size())
+          std::copy_n(stack[top].begin(), width, outputs.begin() + offset);
+      }; break;
+      }
+    }
+  }
+}
+
 } // namespace math
 
 float evaluate(
@@ -331,6 +1001,11 @@ float evaluate(
   if (trimmedInput.empty())
     throw parser_exception("No input");
 
-  auto rpn = math::parse_to_RPN(trimmedInput, vars);
+  std::unordered_map<std::string, math::Token> tokens{};
+  for (const auto &[name, value] : vars) {
+    tokens.emplace(name, value);
+  }
+
+  auto rpn = math::parse_to_RPN(trimmedInput, tokens);
   return math::evaluate_RPN(rpn);
 }
@@ -1,10 +1,14 @@
 #pragma once
+#include <cstdint>
 #include <format>
+#include <optional>
+#include <span>
 #include <stddef.h>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 class parser_exception : public std::runtime_error {
 public:
@@ -48,7 +52,191 @@ union TokenData {
   Operator operator_;
 };
 
-using Token = std::variant<float, Operator>;
+/// Variable, whose value is only known when the expression is evaluated
+struct Variable {
+  size_t slot;
+};
+
+using Token = std::variant<float, Variable, Operator>;
+
+enum class OpCode : uint8_t {
+  Constant,
+  Variable,
+  Add,
+  Subtract,
+  Multiply,
+  Divide,
+  Power,
+  Modulo,
+  Call,
+  /// Push a copy of the top of the stack
+  Duplicate,
+  /// Push the value of a register
+  Load,
+  /// Copy the top of the stack into a register, without popping it
+  Store,
+  /// Pop the top of the stack into an output
+  Output,
+};
+
+/// Function, that can be called from expressions
+struct Function {
+  float (*scalar)(float);
+  /// Applies the function to all the values in place
+  void (*batch)(std::span<float> values);
+  /// Period of the function, 0 when it isn't periodic
+  double period = 0.0;
+};
+
+struct Instruction {
+  OpCode op;
+  union {
+    float constant;
+    /// Variable, register or output
+    uint32_t slot;
+    const Function *function;
+  };
+};
+
+/**
+ * @brief Expressions compiled into a flat stack bytecode
+ *
+ * Variables are resolved to slots and functions to pointers, so evaluation
+ * doesn't allocate or look anything up, it just runs the instructions on a
+ * fixed-size stack. A single program can compute many outputs, values shared
+ * between them are kept in registers.
+ */
+class Program {
+public:
+  static constexpr size_t MAX_STACK = 32;
+  static constexpr size_t MAX_REGISTERS = 64;
+  /// Sets of variables evaluated together by the batched `run`
+  static constexpr size_t LANES = 32;
+
+  Program() = default;
+
+  /// Evaluate the first output, with the values of the variables in the order
+  /// of their slots
+  float operator()(const std::span<const float> variables) const;
+
+  /// Evaluate all outputs at once
+  void run(
+      const std::span<const float> variables, const std::span<float> outputs
+  ) const;
+
+  /**
+   * @brief Evaluate all outputs for `count` sets of variables
+   *
+   * Every instruction is applied to `LANES` sets at once, which amortizes the
+   * dispatch and lets the loops over the lanes vectorize.
+   *
+   * @param variables `variables[slot * count + i]` is the variable in `slot`
+   * of the set `i`
+   * @param outputs `outputs[output * count + i]` receives the `output` of the
+   * set `i`
+   */
+  void run(
+      const size_t count,
+      const std::span<const float> variables,
+      const std::span<float> outputs
+  ) const;
+
+  size_t outputs() const { return output_count; }
+  const std::vector<Instruction> &instructions() const { return code; }
+
+private:
+  std::vector<Instruction> code{};
+  size_t output_count = 0;
+
+  friend class Compiler;
+};
+
+/**
+ * @brief Compiles many expressions into a single optimized program
+ *
+ * Expressions are parsed into one shared expression graph, which is
+ * optimized while it's built:
+ *
+ * - subexpressions with only constant operands are folded into constants
+ * - identities like `x + 0`, `x * 1` or `x ^ 1` are simplified
+ * - equal subexpressions are only stored once, across all the expressions,
+ *   and equal expressions share their output
+ */
+class Compiler {
+public:
+  /// @param names Names of the variables, each one gets the slot of its index.
+  /// `pi` and `e` are always available as constants.
+  explicit Compiler(const std::span<const std::string> names);
+
+  /**
+   * @brief Add an expression to the program
+   *
+   * @return Index of the output with the value of the expression
+   * @throws parser_exception when the expression is invalid
+   */
+  size_t add(const std::string &expr);
+
+  /// @throws parser_exception when an expression doesn't fit on the stack
+  Program build() const;
+
+  /**
+   * @brief Period of an output in a single variable, found symbolically
+   *
+   * Recognizes periodic functions and `%` of linear functions of the variable,
+   * and combinations of them with common periods.
+   *
+   * @return 0 when the output doesn't depend on the variable, `nullopt` when
+   * no period was found
+   */
+  std::optional<double> period(const size_t output, const size_t slot) const;
+
+private:
+  struct Node {
+    OpCode op;
+    float constant = 0.f;
+    uint32_t slot = 0;
+    const Function *function = nullptr;
+    uint32_t left = 0;
+    uint32_t right = 0;
+
+    bool operator==(const Node &other) const;
+  };
+
+  struct NodeHash {
+    size_t operator()(const Node &node) const;
+  };
+
+  struct Emitter;
+
+  uint32_t intern(const Node &node);
+  uint32_t constant(const float value);
+  uint32_t binary(const OpCode op, uint32_t left, uint32_t right);
+  uint32_t call(const Function *function, const uint32_t argument);
+  bool is_constant(const uint32_t node, const float value) const;
+
+  std::unordered_map<std::string, Token> vars{};
+  std::vector<Node> nodes{};
+  std::unordered_map<Node, uint32_t, NodeHash> interned{};
+  /// Root node of each output
+  std::vector<uint32_t> roots{};
+};
+
+/**
+ * @brief Smallest common multiple of two periods, within a small tolerance
+ *
+ * 0 is the period of a constant, so it's neutral. Returns `nullopt` when the
+ * periods aren't commensurable with small multiples.
+ */
+std::optional<double> common_period(const double a, const double b);
+
+/**
+ * @brief Compile a single expression, for repeated evaluation
+ *
+ * @see Compiler
+ * @throws parser_exception when the expression is invalid
+ */
+Program
+compile(const std::string &expr, const std::span<const std::string> names);
 
 } // namespace math
 
@@ -71,6 +259,16 @@ template <> struct std::formatter<math::Operator> {
   }
 };
 
+template <> struct std::formatter<math::Variable> {
+  constexpr auto parse(std::format_parse_context const &ctx) const {
+    return ctx.begin();
+  }
+  template <typename FormatContext>
+  auto format(math::Variable const &variable, FormatContext const &ctx) const {
+    return std::format_to(ctx.out(), "Variable({})", variable.slot);
+  }
+};
+
 template <> struct std::formatter<math::TokenType> {
   constexpr auto parse(std::format_parse_context const &ctx) const {
     return ctx.begin();
@@ -0,0 +1,56 @@
+#include "OccupancyGrid.hpp"
+#include <algorithm>
+#include <cmath>
+
+void OccupancyGrid::reset(
+    const raylib::Rectangle &new_bounds, const float new_cell_size
+) {
+  bounds = new_bounds;
+  cell_size = new_cell_size;
+  columns = std::max(1, static_cast<int>(std::ceil(bounds.width / cell_size)));
+  rows = std::max(1, static_cast<int>(std::ceil(bounds.height / cell_size)));
+
+  cells.resize(static_cast<size_t>(columns * rows));
+  for (auto &cell : cells) {
+    cell.clear();
+  }
+}
+
+int OccupancyGrid::column(const float x) const {
+  return std::clamp(
+      static_cast<int>((x - bounds.x) / cell_size), 0, columns - 1
+  );
+}
+
+int OccupancyGrid::row(const float y) const {
+  return std::clamp(static_cast<int>((y - bounds.y) / cell_size), 0, rows - 1);
+}
+
+void OccupancyGrid::insert(const raylib::Vector2 point) {
+  if (!contains(point))
+    return;
+
+  cells[row(point.y) * columns + column(point.x)].push_back(point);
+}
+
+bool OccupancyGrid::is_occupied(
+    const raylib::Vector2 point, const float distance
+) const {
+  const auto distance_sqr = distance * distance;
+
+  const auto min_column = column(point.x - distance);
+  const auto max_column = column(point.x + distance);
+  const auto min_row = row(point.y - distance);
+  const auto max_row = row(point.y + distance);
+
+  for (int y = min_row; y <= max_row; ++y) {
+    for (int x = min_column; x <= max_column; ++x) {
+      for (const auto &other : cells[y * columns + x]) {
+        if ((other - point).LengthSqr() < distance_sqr)
+          return true;
+      }
+    }
+  }
+
+  return false;
+}
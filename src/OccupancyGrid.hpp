@@ -0,0 +1,46 @@
+#pragma once
+#include <Rectangle.hpp>
+#include <Vector2.hpp>
+#include <vector>
+
+/**
+ * @brief World-space bucket grid of points, used to keep evenly spaced field
+ * lines apart.
+ *
+ * Buckets keep their capacity across `reset`s, so once the grid has warmed up
+ * no allocations happen as long as the layout stays the same.
+ */
+class OccupancyGrid {
+public:
+  OccupancyGrid() = default;
+
+  /**
+   * @brief Remove all points and change the covered area
+   *
+   * @param bounds Covered area, points outside of it are ignored.
+   * @param cell_size Edge of a single bucket, queries are fastest for distances
+   * up to this size.
+   */
+  void reset(const raylib::Rectangle &bounds, const float cell_size);
+
+  void insert(const raylib::Vector2 point);
+
+  /**
+   * @brief Check whether any inserted point is closer than `distance`
+   */
+  bool is_occupied(const raylib::Vector2 point, const float distance) const;
+
+  bool contains(const raylib::Vector2 point) const {
+    return bounds.CheckCollision(point);
+  }
+
+private:
+  int column(const float x) const;
+  int row(const float y) const;
+
+  raylib::Rectangle bounds{};
+  float cell_size = 1.f;
+  int columns = 0;
+  int rows = 0;
+  std::vector<std::vector<raylib::Vector2>> cells{};
+};
@@ -0,0 +1,111 @@
+#include "Particles.hpp"
+#include "defs.hpp"
+#include "field.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <rlgl.h>
+
+void Particles::update(
+    const float timeDelta,
+    const field::Sources &sources,
+    const raylib::Rectangle &view
+) {
+  if (x.size() != count) {
+    x.resize(count);
+    y.resize(count);
+    vx.resize(count);
+    vy.resize(count);
+    ex.resize(count);
+    ey.resize(count);
+    lost.assign(count, 1);
+  }
+
+  respawn(view);
+
+  // Cap the number of steps, so a long frame can't make the next one longer
+  accumulator = std::min(
+      accumulator + timeDelta, PARTICLE_MAX_STEPS * PARTICLE_TIME_STEP
+  );
+  while (accumulator >= PARTICLE_TIME_STEP) {
+    step(PARTICLE_TIME_STEP, sources);
+    accumulator -= PARTICLE_TIME_STEP;
+  }
+
+  constexpr float CAPTURE_RADIUS = 5.f;
+
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      auto outside = x[i] < view.x || x[i] > view.x + view.width ||
+                     y[i] < view.y || y[i] > view.y + view.height;
+
+      auto captured = false;
+      for (size_t j = 0; j < sources.size() && !captured; ++j) {
+        auto dx = x[i] - sources.x[j];
+        auto dy = y[i] - sources.y[j];
+        captured = dx * dx + dy * dy < CAPTURE_RADIUS * CAPTURE_RADIUS;
+      }
+
+      lost[i] = outside || captured;
+    }
+  });
+}
+
+void Particles::step(const float dt, const field::Sources &sources) {
+  field::E(x, y, sources, ex, ey);
+
+  const auto kick = charge_mass_ratio * dt;
+
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      vx[i] += ex[i] * kick;
+      vy[i] += ey[i] * kick;
+      x[i] += vx[i] * dt;
+      y[i] += vy[i] * dt;
+    }
+  });
+}
+
+void Particles::respawn(const raylib::Rectangle &view) {
+  std::uniform_real_distribution<float> dist_x(view.x, view.x + view.width);
+  std::uniform_real_distribution<float> dist_y(view.y, view.y + view.height);
+
+  for (size_t i = 0; i < lost.size(); ++i) {
+    if (!lost[i])
+      continue;
+
+    x[i] = dist_x(rng);
+    y[i] = dist_y(rng);
+    vx[i] = 0.f;
+    vy[i] = 0.f;
+    lost[i] = 0;
+  }
+}
+
+void Particles::draw(const raylib::Rectangle &view, const float zoom) const {
+  // Particles are submitted straight to the render batch, in chunks that are
+  // guaranteed to fit into it
+  constexpr size_t CHUNK = 1024;
+
+  const auto half_size = PARTICLE_SIZE / zoom / 2.f;
+
+  for (size_t start = 0; start < x.size(); start += CHUNK) {
+    const auto end = std::min(x.size(), start + CHUNK);
+
+    rlCheckRenderBatchLimit(static_cast<int>(4 * (end - start)));
+    rlBegin(RL_QUADS);
+    rlColor4ub(color.r, color.g, color.b, color.a);
+
+    for (size_t i = start; i < end; ++i) {
+      if (x[i] < view.x || x[i] > view.x + view.width || y[i] < view.y ||
+          y[i] > view.y + view.height)
+        continue;
+
+      rlVertex2f(x[i] - half_size, y[i] - half_size);
+      rlVertex2f(x[i] - half_size, y[i] + half_size);
+      rlVertex2f(x[i] + half_size, y[i] + half_size);
+      rlVertex2f(x[i] + half_size, y[i] - half_size);
+    }
+
+    rlEnd();
+  }
+}
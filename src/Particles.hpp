@@ -0,0 +1,58 @@
+#pragma once
+#include "defs.hpp"
+#include "field.hpp"
+#include <Color.hpp>
+#include <Rectangle.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Cloud of charged test particles advected through the field
+ *
+ * The particles don't affect the field. State is kept in separate arrays per
+ * component, so the field can be evaluated for all of them in one batch.
+ */
+class Particles {
+public:
+  Particles(
+      const size_t count,
+      const float charge_mass_ratio = PARTICLE_CHARGE_MASS_RATIO,
+      const raylib::Color &color = raylib::Color::SkyBlue()
+  )
+      : count(count), charge_mass_ratio(charge_mass_ratio), color(color) {}
+
+  /**
+   * @brief Advance the particles by `timeDelta` of simulation time
+   *
+   * Integrates in fixed steps with the symplectic Euler method. Particles that
+   * hit a charge or leave the view are respawned at random positions in it.
+   */
+  void update(
+      const float timeDelta,
+      const field::Sources &sources,
+      const raylib::Rectangle &view
+  );
+  void draw(const raylib::Rectangle &view, const float zoom) const;
+
+  size_t size() const { return x.size(); }
+
+private:
+  void step(const float dt, const field::Sources &sources);
+  void respawn(const raylib::Rectangle &view);
+
+  size_t count;
+  float charge_mass_ratio;
+  raylib::Color color;
+  float accumulator = 0.f;
+
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> vx{};
+  std::vector<float> vy{};
+  std::vector<float> ex{};
+  std::vector<float> ey{};
+  std::vector<uint8_t> lost{};
+
+  std::mt19937 rng{std::random_device{}()};
+};
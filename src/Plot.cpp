@@ -4,6 +4,8 @@
 #include "defs.hpp"
 #include "raylib.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <format>
 #include <ranges>
 #include <vector>
@@ -11,17 +13,96 @@
 namespace views = std::views;
 namespace ranges = std::ranges;
 
+void Series::push_back(const float value) {
+  const auto magnitude = std::abs(value);
+
+  // Samples smaller than the new one can never be the maximum again
+  while (!maxima.empty() && maxima.back().second <= magnitude) {
+    maxima.pop_back();
+  }
+  maxima.push_back({pushed, magnitude});
+
+  samples.push_back(value);
+  add_to_columns(pushed, value);
+  ++pushed;
+}
+
+void Series::add_to_columns(const uint64_t number, const float value) {
+  if (columns.empty() || number % _bucket_size == 0) {
+    columns.push_back({value, value});
+    return;
+  }
+
+  auto &column = columns[columns.size() - 1];
+  column.min = std::min(column.min, value);
+  column.max = std::max(column.max, value);
+}
+
+void Series::pop_front() {
+  if (maxima.front().first == popped)
+    maxima.pop_front();
+
+  samples.pop_front();
+  ++popped;
+
+  if (samples.empty()) {
+    columns.clear();
+    return;
+  }
+
+  if (popped % _bucket_size == 0) {
+    columns.pop_front();
+    return;
+  }
+
+  // Recalculate the first column only from the samples left in it
+  auto &column = columns[0];
+  const auto remaining = std::min<size_t>(
+      samples.size(), _bucket_size - popped % _bucket_size
+  );
+  column = {samples[0], samples[0]};
+  for (size_t i = 1; i < remaining; ++i) {
+    column.min = std::min(column.min, samples[i]);
+    column.max = std::max(column.max, samples[i]);
+  }
+}
+
+void Series::clear() {
+  samples.clear();
+  maxima.clear();
+  columns.clear();
+  pushed = 0;
+  popped = 0;
+}
+
+void Series::decimate(const size_t new_bucket_size) {
+  _bucket_size = std::max<size_t>(1, new_bucket_size);
+
+  columns.clear();
+  for (size_t i = 0; i < samples.size(); ++i) {
+    add_to_columns(popped + i, samples[i]);
+  }
+}
+
+size_t Series::column_age(const size_t j) const {
+  const auto first =
+      std::max<uint64_t>(popped, (popped / _bucket_size + j) * _bucket_size);
+  return static_cast<size_t>(pushed - 1 - first);
+}
+
 float row_maxes(auto &data) {
   return ranges::max(data | views::transform([](auto &row) {
-                       auto row_data = std::get<1>(row);
-                       if (row_data.empty())
-                         return 0.f;
-                       auto [min_it, max_row] = ranges::minmax(row_data);
-                       return std::max(std::abs(min_it), max_row);
+                       return std::get<1>(row).max_abs();
                      }));
 }
 
-void Plot::draw(const std::vector<raylib::Color> &probe_colors) const {
+void Plot::render_chrome() {
+  // Rendered into a texture of the size of the plot
+  const raylib::Vector2 position{0.f, 0.f};
+
+  chrome.BeginMode();
+  ClearBackground(BLANK);
+
   auto border = raylib::Vector2{2.f, 2.f};
   accent_color.DrawRectangle(position, size);
   background_color.DrawRectangle(position + border, size - border * 2.f);
@@ -69,9 +150,7 @@ void Plot::draw(const std::vector<raylib::Color> &probe_colors) const {
       accent_color
   );
 
-  float max = row_maxes(data);
-
-  auto display_max = max * K_E;
+  auto display_max = scale * K_E;
 
   auto y_max_value_text = std::format(" {:.2g}", display_max);
   raylib::DrawText(
@@ -159,51 +238,317 @@ void Plot::draw(const std::vector<raylib::Color> &probe_colors) const {
     );
   }
 
-  std::vector<raylib::Vector2> draw_buffer;
-  draw_buffer.reserve(resolution);
+  chrome.EndMode();
+}
+
+raylib::Rectangle Plot::graph_area() const {
+  return {
+      4.f + FONT_SIZE_SMALL,
+      2.f,
+      size.x - 6.f - FONT_SIZE_SMALL,
+      size.y - 2.f
+  };
+}
+
+void Plot::draw_series(
+    const Series &row_data,
+    const int offset,
+    const raylib::Color color,
+    const size_t max_age
+) {
+  const auto area = graph_area();
+  // Same as the graph size in `render_chrome`
+  const auto width = area.width - 2.f;
+  const auto height = area.height - 2.f * FONT_SIZE_SMALL;
+  const auto vertical_midpoint = area.height / 2.f;
+  const auto resolution_f = static_cast<float>(resolution);
+
+  auto y = [&](float value) {
+    return vertical_midpoint -
+           (scale > 0.f ? height * value / scale / 2.f : 0.f);
+  };
+
+  // Start at the right edge. Each column is drawn as a vertical stroke from
+  // its minimum to its maximum, so spikes stay visible no matter how many
+  // samples it holds.
+  for (size_t j = row_data.column_count(); j-- > 0;) {
+    auto [min, max] = row_data.column(j);
+    auto age = row_data.column_age(j) + offset;
+    auto x = area.width - width * age / resolution_f;
+    draw_buffer.emplace_back(x, y(max));
+    draw_buffer.emplace_back(x, y(min));
+
+    // One older column than needed connects to what's already drawn
+    if (age >= max_age)
+      break;
+  }
+
+  color.DrawLineStrip(draw_buffer.data(), draw_buffer.size());
+  draw_buffer.clear();
+}
+
+float Plot::scroll_position(const uint64_t step) const {
+  const auto width = graph_area().width - 2.f;
+  return std::floor(
+      static_cast<float>(step) * width / static_cast<float>(resolution)
+  );
+}
+
+void Plot::render_series(const std::vector<raylib::Color> &probe_colors) {
+  auto &target = series[front];
+  target.BeginMode();
+  ClearBackground(BLANK);
+  for (auto [row, color] : ranges::zip_view(data, probe_colors)) {
+    auto &[offset, row_data] = row;
+    draw_series(row_data, offset, color, SIZE_MAX);
+  }
+  target.EndMode();
+}
+
+void Plot::scroll_series(const std::vector<raylib::Color> &probe_colors) {
+  const auto area = graph_area();
+  const auto advanced = steps - rendered_steps;
+  const auto shift = scroll_position(steps) - scroll_position(rendered_steps);
 
-  auto resolution_f = static_cast<float>(this->resolution);
-  // for each row in data
+  // Copy the old contents shifted to the left into the other texture, only
+  // the newly exposed strip is drawn again
+  const auto &source = series[front];
+  front = 1 - front;
+  auto &target = series[front];
+
+  target.BeginMode();
+  ClearBackground(BLANK);
+  DrawTextureRec(
+      source.texture,
+      {0.f, 0.f, area.width, -area.height},
+      {-shift, 0.f},
+      WHITE
+  );
   for (auto [row, color] : ranges::zip_view(data, probe_colors)) {
     auto &[offset, row_data] = row;
-    // start at right edge and add points to the buffer
-    for (auto [i, value] :
-         row_data | views::as_const | views::reverse | views::enumerate) {
-      auto draw_value = graph_size.y * value / max / 2.f;
-      auto x_offset = graph_size.x * (i + offset) / resolution_f;
-      draw_buffer.emplace_back(
-          right_edge - x_offset, vertical_midpoint - draw_value
+    // The last column might have grown since it was drawn
+    draw_series(row_data, offset, color, advanced + row_data.bucket_size());
+  }
+  target.EndMode();
+}
+
+void Plot::draw(const std::vector<raylib::Color> &probe_colors) {
+  const auto area = graph_area();
+  if (area.width < 1.f || area.height < 1.f)
+    return;
+
+  if (size != rendered_size) {
+    chrome = raylib::RenderTexture2D(
+        static_cast<int>(size.x), static_cast<int>(size.y)
+    );
+    for (auto &target : series) {
+      target = raylib::RenderTexture2D(
+          static_cast<int>(area.width), static_cast<int>(area.height)
       );
     }
+    rendered_size = size;
+    chrome_dirty = true;
+    series_dirty = true;
+  }
+
+  // The range only changes, when the samples outgrow it or shrink way below
+  // it, so the axes aren't redrawn with every new maximum
+  const auto max = row_maxes(data);
+  if (max > scale || max < scale / 4.f) {
+    scale = max * 1.25f;
+    chrome_dirty = true;
+    series_dirty = true;
+  }
 
-    color.DrawLineStrip(draw_buffer.data(), draw_buffer.size());
-    draw_buffer.clear();
+  if (chrome_dirty) {
+    render_chrome();
+    chrome_dirty = false;
   }
+
+  if (series_dirty || steps - rendered_steps >= resolution) {
+    render_series(probe_colors);
+    series_dirty = false;
+  } else if (steps != rendered_steps) {
+    scroll_series(probe_colors);
+  }
+  rendered_steps = steps;
+
+  // Render textures are stored upside down
+  DrawTextureRec(
+      chrome.texture, {0.f, 0.f, size.x, -size.y}, position, WHITE
+  );
+  DrawTextureRec(
+      series[front].texture,
+      {0.f, 0.f, area.width, -area.height},
+      position + raylib::Vector2{area.x, area.y},
+      WHITE
+  );
+}
+
+size_t Plot::bucket_size() const {
+  // Same as the width of the graph in `draw`
+  auto graph_width = size.x - 8.f - static_cast<float>(FONT_SIZE_SMALL);
+  return static_cast<size_t>(std::max(
+      1.f,
+      std::ceil(static_cast<float>(resolution) / std::max(1.f, graph_width))
+  ));
 }
 
-// TODO: fix timing
 void Plot::update(
-    const float,
-    const double elapsedTime,
-    const float speed,
-    const std::vector<std::optional<Probe>> &probes
+    const double simulationTime,
+    const std::span<const Charge> &charges,
+    const std::vector<std::optional<Probe>> &probes,
+    const Symmetry &symmetry
 ) {
+  // Fresh plot starts at the current time
+  if (data.empty())
+    next_sample_time = simulationTime;
+
   while (data.size() < probes.size())
-    data.emplace_back(0, std::deque<float>());
+    data.emplace_back(0, Series(resolution));
+
+  const auto bucket = bucket_size();
+  for (auto &[offset, row_data] : data) {
+    if (row_data.bucket_size() != bucket)
+      row_data.decimate(bucket);
+  }
+
+  // Samples older than the history would be dropped right away
+  const auto history = static_cast<double>(resolution) / PLOT_SAMPLE_RATE;
+  next_sample_time = std::max(next_sample_time, simulationTime - history);
 
-  // sample at most 60 times per second of simulation
-  if (elapsedTime - last_update <= 1.0 / 61.0 / speed)
+  sample_times.clear();
+  while (next_sample_time <= simulationTime) {
+    sample_times.push_back(next_sample_time);
+    next_sample_time += 1.0 / PLOT_SAMPLE_RATE;
+  }
+
+  if (sample_times.empty())
     return;
 
-  last_update = elapsedTime;
+  const auto new_samples = sample_times.size();
+  steps += new_samples;
+
+  sources.assign(charges, simulationTime);
+  strengths.resize(charges.size() * new_samples);
+  for (size_t j = 0; j < charges.size(); ++j) {
+    charges[j].strengths_at(
+        sample_times,
+        std::span(strengths).subspan(j * new_samples, new_samples)
+    );
+  }
+
+  probe_x.clear();
+  probe_y.clear();
+  for (const auto &probe : probes) {
+    if (probe.has_value()) {
+      auto position = probe->position();
+      probe_x.push_back(position.x);
+      probe_y.push_back(position.y);
+    }
+  }
 
+  potentials.resize(probe_x.size() * new_samples);
+  if (recorder != nullptr) {
+    field_x.resize(potentials.size());
+    field_y.resize(potentials.size());
+  }
+
+  // Every probe evaluates all the sources in each of the new samples, with
+  // few of them that's cheaper than the reduction
+  const auto evaluations = charges.size() * new_samples;
+  const auto reduce =
+      !symmetry.trivial() && evaluations >= SYMMETRY_MIN_SOURCES;
+  if (reduce)
+    orbits.assign(symmetry, probe_x, probe_y);
+
+  if (reduce && orbits.size() < probe_x.size()) {
+    orbit_values.resize(orbits.size() * new_samples);
+    field::potential_series(
+        orbits.x(),
+        orbits.y(),
+        sources,
+        sample_times,
+        strengths,
+        orbit_values,
+        series_scratch
+    );
+    orbits.expand(orbit_values, potentials, new_samples);
+
+    if (recorder != nullptr) {
+      orbit_x.resize(orbit_values.size());
+      orbit_y.resize(orbit_values.size());
+      field::E_series(
+          orbits.x(),
+          orbits.y(),
+          sources,
+          sample_times,
+          strengths,
+          orbit_x,
+          orbit_y,
+          series_scratch
+      );
+      orbits.expand(orbit_x, orbit_y, field_x, field_y, new_samples);
+    }
+  } else {
+    field::potential_series(
+        probe_x,
+        probe_y,
+        sources,
+        sample_times,
+        strengths,
+        potentials,
+        series_scratch
+    );
+
+    if (recorder != nullptr) {
+      field::E_series(
+          probe_x,
+          probe_y,
+          sources,
+          sample_times,
+          strengths,
+          field_x,
+          field_y,
+          series_scratch
+      );
+    }
+  }
+
+  size_t live_probe = 0;
   for (auto [row, probe] : ranges::zip_view(data, probes)) {
     auto &[offset, row_data] = row;
-    if (probe == std::nullopt && offset < static_cast<int>(resolution)) {
-      offset += speed;
+    if (probe == std::nullopt) {
+      if (offset < static_cast<int>(resolution))
+        offset += static_cast<int>(new_samples);
     } else {
-      for (int i = 0; i < speed; i++) {
-        row_data.push_back(probe->sample_potencial());
+      const auto first = live_probe * new_samples;
+      const auto probe_potentials =
+          std::span(potentials).subspan(first, new_samples);
+      ++live_probe;
+
+      const auto index = static_cast<size_t>(&row - data.data());
+
+      if (spectrum != nullptr)
+        spectrum->append(index, probe_potentials);
+
+      if (recorder != nullptr) {
+        recorder->append(
+            sample_times,
+            static_cast<uint32_t>(index),
+            probe_potentials,
+            std::span(field_x).subspan(first, new_samples),
+            std::span(field_y).subspan(first, new_samples)
+        );
+      }
+
+      for (auto potential : probe_potentials) {
+        // Keep the newest sample, and all other ones, that fit
+        while (row_data.size() + 1 + offset >= resolution &&
+               !row_data.empty()) {
+          row_data.pop_front();
+        }
+        row_data.push_back(potential);
       }
     }
 
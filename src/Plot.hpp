@@ -1,9 +1,80 @@
+#include "Charge.hpp"
 #include "Probe.hpp"
+#include "Recorder.hpp"
+#include "RingBuffer.hpp"
+#include "Spectrum.hpp"
+#include "Symmetry.hpp"
+#include "defs.hpp"
+#include "field.hpp"
 #include <Color.hpp>
+#include <Rectangle.hpp>
+#include <RenderTexture.hpp>
 #include <Vector2.hpp>
-#include <deque>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
+/**
+ * @brief History of samples of a single probe
+ *
+ * Keeps the maximum absolute value of the stored samples in a monotonic queue,
+ * so it's available in O(1) and maintained in amortized O(1) per sample.
+ *
+ * Samples are also reduced to columns of `bucket_size` consecutive samples,
+ * each holding their minimum and maximum, for drawing at the resolution of
+ * the screen. Columns are aligned to sample numbers, so adding a sample only
+ * touches the last column and removing one only the first.
+ */
+class Series {
+public:
+  struct Column {
+    float min;
+    float max;
+  };
+
+  explicit Series(const size_t capacity)
+      : samples(capacity), maxima(capacity), columns(capacity) {}
+
+  void push_back(const float value);
+  void pop_front();
+  void clear();
+
+  /// Regroup the samples into columns of a new size
+  void decimate(const size_t new_bucket_size);
+  size_t bucket_size() const { return _bucket_size; }
+
+  size_t column_count() const { return columns.size(); }
+  /// `0` is the oldest column
+  Column column(const size_t j) const { return columns[j]; }
+  /// Age of the oldest sample in the column, `0` is the newest sample
+  size_t column_age(const size_t j) const;
+
+  size_t size() const { return samples.size(); }
+  bool empty() const { return samples.empty(); }
+  bool full() const { return samples.full(); }
+  /// `0` is the oldest sample
+  float operator[](const size_t i) const { return samples[i]; }
+
+  float max_abs() const {
+    return maxima.empty() ? 0.f : maxima.front().second;
+  }
+
+private:
+  RingBuffer<float> samples;
+  // Candidates for the maximum as (sample number, absolute value), both the
+  // numbers and the values are decreasing from front to back
+  RingBuffer<std::pair<uint64_t, float>> maxima;
+  RingBuffer<Column> columns;
+  size_t _bucket_size = 1;
+  uint64_t pushed = 0;
+  uint64_t popped = 0;
+
+  void add_to_columns(const uint64_t number, const float value);
+};
+
 class Plot {
 public:
   Plot(
@@ -15,27 +86,99 @@ public:
       : position(position), size(size), background_color(background_color),
         accent_color(accent_color) {};
 
-  void draw(const std::vector<raylib::Color> &probe_colors) const;
+  /**
+   * @brief Draw the plot
+   *
+   * Axes and labels are cached in a texture, that is redrawn only when the
+   * size or the range changes. Series are cached in another texture, which is
+   * scrolled by the new samples, only the newly exposed strip gets drawn.
+   */
+  void draw(const std::vector<raylib::Color> &probe_colors);
+  /**
+   * @brief Sample the probes up to the given time
+   *
+   * Probes are sampled at a fixed rate of simulation time, independent of the
+   * frame rate. Strengths of the charges in all the new sample times are
+   * computed at once, and so are the potentials of all the probes. Probes in
+   * images of each other under the `symmetry` of the charges share them.
+   */
   void update(
-      const float timeDelta,
-      const double elapsedTime,
-      const float speed,
-      const std::vector<std::optional<Probe>> &probe
+      const double simulationTime,
+      const std::span<const Charge> &charges,
+      const std::vector<std::optional<Probe>> &probes,
+      const Symmetry &symmetry
   );
   void
   resize(const raylib::Vector2 new_position, const raylib::Vector2 new_size) {
     position = new_position;
     size = new_size;
   }
-  void clear() { data.clear(); }
+  /// Also append all new samples to the recording, `nullptr` to stop
+  void record_to(Recorder *new_recorder) { recorder = new_recorder; }
+  /// Also feed all new samples to the spectrum, `nullptr` to stop
+  void analyze_with(Spectrum *new_spectrum) { spectrum = new_spectrum; }
+  void clear() {
+    data.clear();
+    series_dirty = true;
+  }
 
 private:
-  const size_t resolution = 30 * 60; // 30 seconds at 60 samples per second
+  /// Samples per pixel column of the graph
+  size_t bucket_size() const;
+  /// Area of the series, relative to the plot
+  raylib::Rectangle graph_area() const;
+  /// Horizontal position in pixels of the given step, for scrolling
+  float scroll_position(const uint64_t step) const;
+
+  void render_chrome();
+  void render_series(const std::vector<raylib::Color> &probe_colors);
+  void scroll_series(const std::vector<raylib::Color> &probe_colors);
+  /// Draw columns of a series with age up to `max_age` into the bound target
+  void draw_series(
+      const Series &row_data,
+      const int offset,
+      const raylib::Color color,
+      const size_t max_age
+  );
+
+  const size_t resolution =
+      static_cast<size_t>(PLOT_HISTORY * PLOT_SAMPLE_RATE);
   raylib::Vector2 position;
   raylib::Vector2 size;
   raylib::Color background_color;
   raylib::Color accent_color;
-  double last_update = 0.0;
+  double next_sample_time = 0.0;
+
+  std::vector<std::tuple<int, Series>> data{};
+  /// Samples added to every row so far
+  uint64_t steps = 0;
+
+  // Buffers for sampling
+  std::vector<double> sample_times{};
+  field::Sources sources{};
+  std::vector<float> strengths{};
+  std::vector<float> probe_x{};
+  std::vector<float> probe_y{};
+  std::vector<float> potentials{};
+  std::vector<float> field_x{};
+  std::vector<float> field_y{};
+  /// Working memory of the series evaluation
+  std::vector<float> series_scratch{};
+  Orbits orbits{};
+  std::vector<float> orbit_values{};
+  std::vector<float> orbit_x{};
+  std::vector<float> orbit_y{};
+  Recorder *recorder = nullptr;
+  Spectrum *spectrum = nullptr;
 
-  std::vector<std::tuple<int, std::deque<float>>> data{};
+  // Cached rendering
+  raylib::RenderTexture2D chrome{};
+  std::array<raylib::RenderTexture2D, 2> series{};
+  size_t front = 0;
+  raylib::Vector2 rendered_size{};
+  uint64_t rendered_steps = 0;
+  float scale = 0.f;
+  bool chrome_dirty = true;
+  bool series_dirty = true;
+  std::vector<raylib::Vector2> draw_buffer{};
 };
@@ -1,49 +1,42 @@
 #pragma once
 #include <Vector2.hpp>
 #include <format>
-
-class Position {
-public:
-  virtual raylib::Vector2 operator()() const = 0;
-  virtual void update(const float timeDelta, const float elapsedTime) = 0;
-  virtual ~Position() = default;
-  friend struct std::formatter<Position>;
-};
+#include <variant>
 
 namespace position {
 
-class Static : public Position {
+class Static {
 public:
   explicit Static(const raylib::Vector2 &position) : _position(position) {}
-  raylib::Vector2 operator()() const final { return _position; }
+  raylib::Vector2 operator()() const { return _position; }
   void update(
       [[maybe_unused]] const float timeDelta,
       [[maybe_unused]] const float elapsedTime
-  ) final {
+  ) {
     // static position doesn't need update, provided just for interface sake
   }
 
 private:
-  const raylib::Vector2 _position;
+  raylib::Vector2 _position;
   friend struct std::formatter<Static>;
 };
 
-class Rotating : public Position {
+class Rotating {
 public:
   explicit Rotating(
       const raylib::Vector2 &position, const float radius, const float velocity
   )
       : _position(position), _radius(radius),
         _offset(raylib::Vector2{radius, 0}), _velocity(velocity) {}
-  raylib::Vector2 operator()() const final { return _position + _offset; }
-  void update([[maybe_unused]] const float timeDelta, const float elapsedTime)
-      final {
+  raylib::Vector2 operator()() const { return _position + _offset; }
+  void
+  update([[maybe_unused]] const float timeDelta, const float elapsedTime) {
     _offset = raylib::Vector2{_radius, 0}.Rotate(_velocity * elapsedTime);
   }
 
 private:
-  const raylib::Vector2 _position;
-  const float _radius;
+  raylib::Vector2 _position;
+  float _radius;
   raylib::Vector2 _offset;
   float _velocity;
 
@@ -52,23 +45,37 @@ private:
 
 } // namespace position
 
+/**
+ * @brief Motion of a point
+ *
+ * A closed set of alternatives, so it's stored by value and dispatched without
+ * virtual calls.
+ */
+using Position = std::variant<position::Static, position::Rotating>;
+
+namespace position {
+
+inline raylib::Vector2 current(const Position &position) {
+  return std::visit([](const auto &p) { return p(); }, position);
+}
+
+inline void update(
+    Position &position, const float timeDelta, const float elapsedTime
+) {
+  std::visit([=](auto &p) { p.update(timeDelta, elapsedTime); }, position);
+}
+
+} // namespace position
+
 template <> struct std::formatter<Position> {
   constexpr auto parse(std::format_parse_context const &ctx) const {
     return ctx.begin();
   }
   template <typename FormatContext>
   auto format(const Position &p, FormatContext &ctx) const {
-    if (dynamic_cast<const position::Static *>(&p)) {
-      return std::format_to(
-          ctx.out(), "{}", dynamic_cast<const position::Static &>(p)
-      );
-    } else if (dynamic_cast<const position::Rotating *>(&p)) {
-      return std::format_to(
-          ctx.out(), "{}", dynamic_cast<const position::Rotating &>(p)
-      );
-    } else {
-      return std::format_to(ctx.out(), "{}", p());
-    }
+    return std::visit(
+        [&ctx](const auto &p) { return std::format_to(ctx.out(), "{}", p); }, p
+    );
   }
 };
 
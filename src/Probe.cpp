@@ -2,6 +2,9 @@
 #include "Charge.hpp"
 #include "Vector2.hpp"
 #include "field.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <rlgl.h>
 #include <span>
 
 void Probe::update(
@@ -9,25 +12,22 @@ void Probe::update(
     const double elapsedTime,
     const std::span<Charge> &charges
 ) {
-  _position->update(timeDelta, elapsedTime);
-  _sample = field::E((*_position)(), charges);
-  _sample_potencial = field::potential((*_position)(), charges);
+  position::update(_position, timeDelta, elapsedTime);
+  _sample = field::E(position(), charges, elapsedTime);
+  _sample_potencial = field::potential(position(), charges, elapsedTime);
 }
 
-void ProbeRenderer::draw_to_buffer(const Probe &probe) {
-  auto position = probe.position();
-
-  auto sample = probe.sample();
-
-  auto color = lerpColor(
-      raylib::Color::Gray(),
-      probe._color,
-      1.f / (1.f + std::exp(-sample.Length() / 1e10f))
-  );
-
+void ProbeRenderer::arrow(
+    const raylib::Vector2 position,
+    const raylib::Vector2 sample,
+    const raylib::Color color,
+    const float length,
+    Vertex *line,
+    Vertex *triangle
+) {
   auto direction = sample.Normalize();
 
-  auto draw_sample = direction.Scale(probe.length);
+  auto draw_sample = direction.Scale(length);
 
   auto tip = position + draw_sample;
 
@@ -37,29 +37,110 @@ void ProbeRenderer::draw_to_buffer(const Probe &probe) {
 
   auto head_base = position + draw_sample.Scale(line_scale);
 
-  // Draw the line
-  line_buffer.emplace_back(position, head_base, color);
+  // The line
+  line[0] = {position, color};
+  line[1] = {head_base, color};
 
   // Calculate points for the arrowhead
-  float head_width = probe.length * head_scale / 2.f;
+  float head_width = length * head_scale / 2.f;
   raylib::Vector2 perpendicular(-direction.y, direction.x);
   auto head_left = head_base + perpendicular.Scale(head_width);
   auto head_right = head_base - perpendicular.Scale(head_width);
 
-  // Draw the triangular arrowhead
-  triangle_buffer.emplace_back(head_left, tip, head_right, color);
+  // The triangular arrowhead
+  triangle[0] = {head_left, color};
+  triangle[1] = {tip, color};
+  triangle[2] = {head_right, color};
+}
+
+void ProbeRenderer::clear() {
+  line_buffer.clear();
+  triangle_buffer.clear();
 }
 
-void ProbeRenderer::flush() {
-  for (const auto &line : line_buffer) {
-    line.color.DrawLine(line.start, line.end);
+void ProbeRenderer::draw_to_buffer(const ProbeField &probes) {
+  indices.clear();
+  for (size_t i = 0; i < probes.size(); ++i) {
+    if (probes.visible(i))
+      indices.push_back(i);
   }
 
-  line_buffer.clear();
+  const auto line_offset = line_buffer.size();
+  const auto triangle_offset = triangle_buffer.size();
+
+  line_buffer.resize(line_offset + 2 * indices.size());
+  triangle_buffer.resize(triangle_offset + 3 * indices.size());
+
+  // Every visible probe has its own fixed place in the buffers
+  parallel::for_each(indices.size(), [&](size_t start, size_t end) {
+    for (size_t j = start; j < end; ++j) {
+      auto i = indices[j];
+      arrow(
+          probes.position(i),
+          probes.sample(i),
+          probes.color(i),
+          probes.length,
+          &line_buffer[line_offset + 2 * j],
+          &triangle_buffer[triangle_offset + 3 * j]
+      );
+    }
+  });
+}
+
+void ProbeRenderer::draw_to_buffer(
+    const raylib::Vector2 position,
+    const raylib::Vector2 sample,
+    const raylib::Color color,
+    const float length
+) {
+  line_buffer.resize(line_buffer.size() + 2);
+  triangle_buffer.resize(triangle_buffer.size() + 3);
+
+  arrow(
+      position,
+      sample,
+      color,
+      length,
+      &line_buffer[line_buffer.size() - 2],
+      &triangle_buffer[triangle_buffer.size() - 3]
+  );
+}
+
+void ProbeRenderer::add_line(
+    const raylib::Vector2 start,
+    const raylib::Vector2 end,
+    const raylib::Color color
+) {
+  line_buffer.push_back({start, color});
+  line_buffer.push_back({end, color});
+}
 
-  for (const auto &triangle : triangle_buffer) {
-    DrawTriangle(triangle.a, triangle.b, triangle.c, triangle.color);
+/**
+ * @brief Submit vertices to the render batch, in chunks that are guaranteed
+ * to fit into it
+ */
+template <typename Vertex>
+void submit(const int mode, const std::span<const Vertex> vertices) {
+  // divisible by both 2 and 3, so no primitive is split between chunks
+  constexpr size_t CHUNK = 6 * 512;
+
+  for (size_t start = 0; start < vertices.size(); start += CHUNK) {
+    const auto end = std::min(vertices.size(), start + CHUNK);
+
+    rlCheckRenderBatchLimit(static_cast<int>(end - start));
+    rlBegin(mode);
+
+    for (size_t i = start; i < end; ++i) {
+      const auto &[position, color] = vertices[i];
+      rlColor4ub(color.r, color.g, color.b, color.a);
+      rlVertex2f(position.x, position.y);
+    }
+
+    rlEnd();
   }
+}
 
-  triangle_buffer.clear();
+void ProbeRenderer::flush() const {
+  submit<Vertex>(RL_LINES, line_buffer);
+  submit<Vertex>(RL_TRIANGLES, triangle_buffer);
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "Charge.hpp"
+#include "Label.hpp"
 #include "Position.hpp"
+#include "ProbeField.hpp"
 #include "defs.hpp"
 #include "raylib.h"
 #include "utils.hpp"
@@ -9,21 +11,20 @@
 #include <Vector2.hpp>
 #include <cmath>
 #include <format>
-#include <memory>
 #include <print>
 #include <span>
 #include <utility>
+#include <vector>
 
 class Probe {
 public:
   Probe(
-      std::unique_ptr<Position> position,
+      const Position &position,
       const raylib::Color &color,
       float radius = 8.f,
       float length = 60.f
   )
-      : radius(radius), length(length), _position(std::move(position)),
-        _color(color) {}
+      : radius(radius), length(length), _position(position), _color(color) {}
 
   Probe(Probe &&) = default;
   Probe &operator=(Probe &&) = default;
@@ -35,7 +36,7 @@ public:
   );
 
   template <const bool ONLY_ARROW = false> void draw() const {
-    auto position = (*_position)();
+    auto position = this->position();
 
     auto sample = this->sample();
 
@@ -48,15 +49,8 @@ public:
     if constexpr (!ONLY_ARROW) {
       position.DrawCircle(radius, color);
 
-      auto msg = std::format("E = {:.1E} N/C", K_E * sample.Length());
-      int width = raylib::MeasureText(msg, FONT_SIZE);
-      raylib::DrawText(
-          msg.c_str(),
-          position.x - width / 2.f,
-          position.y - 2 * FONT_SIZE,
-          FONT_SIZE,
-          color
-      );
+      label.update(round_significant(K_E * sample.Length(), 2));
+      label.draw_centered({position.x, position.y - 2 * FONT_SIZE}, color);
     }
 
     auto direction = sample.Normalize();
@@ -84,23 +78,24 @@ public:
     DrawTriangle(head_left, tip, head_right, color);
   }
 
-  raylib::Vector2 position() const { return (*_position)(); }
+  raylib::Vector2 position() const { return position::current(_position); }
   raylib::Vector2 sample() const { return _sample; }
   float sample_potencial() const { return _sample_potencial; }
 
   bool contains(const raylib::Vector2 &point) const {
-    return (point - (*_position)()).Length() < radius;
+    return (point - position()).Length() < radius;
   }
 
   float radius;
   float length = 50.f;
 
 private:
-  std::unique_ptr<Position> _position;
+  Position _position;
   raylib::Color _color;
   raylib::Vector2 _sample;
   float _sample_potencial;
   int _id;
+  mutable Label<float> label{"E = {:.1E} N/C", FONT_SIZE};
 
   friend struct std::formatter<Probe>;
   friend class ProbeRenderer;
@@ -113,34 +108,63 @@ template <> struct std::formatter<Probe> {
   template <typename FormatContext>
   auto format(const Probe &p, FormatContext &ctx) const {
     return std::format_to(
-        ctx.out(), "Probe(position: {}, sample: {})", *p._position, p._sample
+        ctx.out(), "Probe(position: {}, sample: {})", p._position, p._sample
     );
   }
 };
 
+/**
+ * @brief Batched renderer of probe arrows and lines
+ *
+ * Geometry is written into persistent vertex buffers, which keep their
+ * capacity across frames, and submitted through rlgl in as few batches as
+ * possible instead of one draw call per element.
+ */
 class ProbeRenderer {
 public:
   ProbeRenderer() = default;
   ProbeRenderer(ProbeRenderer &&) = default;
   ProbeRenderer &operator=(ProbeRenderer &&) = default;
 
-  void draw_to_buffer(const Probe &probe);
-  void flush();
+  /// Remove all geometry
+  void clear();
+
+  /// Add arrows of all visible probes, generated in parallel
+  void draw_to_buffer(const ProbeField &probes);
+
+  void draw_to_buffer(
+      const raylib::Vector2 position,
+      const raylib::Vector2 sample,
+      const raylib::Color color,
+      const float length
+  );
+
+  void add_line(
+      const raylib::Vector2 start,
+      const raylib::Vector2 end,
+      const raylib::Color color
+  );
+
+  /// Submit all geometry
+  void flush() const;
 
 private:
-  struct Line {
-    raylib::Vector2 start;
-    raylib::Vector2 end;
+  struct Vertex {
+    raylib::Vector2 position;
     raylib::Color color;
   };
 
-  struct Triangle {
-    raylib::Vector2 a;
-    raylib::Vector2 b;
-    raylib::Vector2 c;
-    raylib::Color color;
-  };
+  /// Write the 2 line and 3 triangle vertices of a single arrow
+  static void arrow(
+      const raylib::Vector2 position,
+      const raylib::Vector2 sample,
+      const raylib::Color color,
+      const float length,
+      Vertex *line,
+      Vertex *triangle
+  );
 
-  std::vector<Line> line_buffer;
-  std::vector<Triangle> triangle_buffer;
+  std::vector<Vertex> line_buffer;
+  std::vector<Vertex> triangle_buffer;
+  std::vector<size_t> indices;
 };
@@ -0,0 +1,167 @@
+#include "ProbeField.hpp"
+#include "defs.hpp"
+#include "parallel.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <variant>
+
+void ProbeField::clear() {
+  motions.clear();
+  base_colors.clear();
+  x.clear();
+  y.clear();
+  sample_x.clear();
+  sample_y.clear();
+  potentials.clear();
+  colors.clear();
+  moving = 0;
+  stale.clear();
+  _visible.clear();
+}
+
+void ProbeField::reserve(const size_t count) {
+  motions.reserve(count);
+  base_colors.reserve(count);
+  x.reserve(count);
+  y.reserve(count);
+  sample_x.reserve(count);
+  sample_y.reserve(count);
+  potentials.reserve(count);
+  colors.reserve(count);
+  stale.reserve(count);
+  _visible.reserve(count);
+}
+
+void ProbeField::push_back(
+    const Position &motion, const raylib::Color &color
+) {
+  auto position = position::current(motion);
+
+  motions.push_back(motion);
+  base_colors.push_back(color);
+  x.push_back(position.x);
+  y.push_back(position.y);
+  sample_x.push_back(0.f);
+  sample_y.push_back(0.f);
+  potentials.push_back(0.f);
+  colors.push_back(color);
+
+  if (!std::holds_alternative<position::Static>(motion))
+    ++moving;
+
+  stale.push_back(1);
+  _visible.push_back(0);
+}
+
+void ProbeField::set(
+    const size_t i, const Position &motion, const raylib::Color &color
+) {
+  auto position = position::current(motion);
+
+  if (!std::holds_alternative<position::Static>(motions[i]))
+    --moving;
+  if (!std::holds_alternative<position::Static>(motion))
+    ++moving;
+
+  motions[i] = motion;
+  base_colors[i] = color;
+  x[i] = position.x;
+  y[i] = position.y;
+
+  stale[i] = 1;
+  _visible[i] = 0;
+}
+
+void ProbeField::update_color(const size_t i) {
+  auto magnitude = std::hypot(sample_x[i], sample_y[i]);
+  colors[i] = lerpColor(
+      raylib::Color::Gray(),
+      base_colors[i],
+      1.f / (1.f + std::exp(-magnitude / 1e10f))
+  );
+}
+
+bool ProbeField::update(
+    const float timeDelta,
+    const double elapsedTime,
+    const field::Sources &sources,
+    const raylib::Rectangle &bounds,
+    const Symmetry &symmetry
+) {
+  const auto count = motions.size();
+
+  if (moving > 0 || sources != evaluated_sources) {
+    std::fill(stale.begin(), stale.end(), 1);
+    evaluated_sources = sources;
+  }
+
+  if (moving > 0) {
+    parallel::for_each(count, [&](size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        position::update(motions[i], timeDelta, elapsedTime);
+        auto position = position::current(motions[i]);
+        x[i] = position.x;
+        y[i] = position.y;
+      }
+    });
+  }
+
+  batch.clear();
+  for (size_t i = 0; i < count; ++i) {
+    _visible[i] = bounds.CheckCollision(raylib::Vector2{x[i], y[i]});
+    if (_visible[i] && stale[i])
+      batch.push_back(i);
+  }
+
+  if (batch.empty())
+    return false;
+
+  const auto batch_size = batch.size();
+
+  batch_x.resize(batch_size);
+  batch_y.resize(batch_size);
+  batch_sample_x.resize(batch_size);
+  batch_sample_y.resize(batch_size);
+  batch_potentials.resize(batch_size);
+
+  for (size_t j = 0; j < batch_size; ++j) {
+    batch_x[j] = x[batch[j]];
+    batch_y[j] = y[batch[j]];
+  }
+
+  // With few sources, evaluating every probe is cheaper than the reduction
+  const auto reduce =
+      !symmetry.trivial() && sources.size() >= SYMMETRY_MIN_SOURCES;
+  if (reduce)
+    orbits.assign(symmetry, batch_x, batch_y);
+
+  if (reduce && orbits.size() < batch_size) {
+    orbit_sample_x.resize(orbits.size());
+    orbit_sample_y.resize(orbits.size());
+    orbit_potentials.resize(orbits.size());
+
+    field::E(orbits.x(), orbits.y(), sources, orbit_sample_x, orbit_sample_y);
+    field::potential(orbits.x(), orbits.y(), sources, orbit_potentials);
+    orbits.expand(
+        orbit_sample_x, orbit_sample_y, batch_sample_x, batch_sample_y
+    );
+    orbits.expand(orbit_potentials, batch_potentials);
+  } else {
+    field::E(batch_x, batch_y, sources, batch_sample_x, batch_sample_y);
+    field::potential(batch_x, batch_y, sources, batch_potentials);
+  }
+
+  parallel::for_each(batch_size, [&](size_t start, size_t end) {
+    for (size_t j = start; j < end; ++j) {
+      auto i = batch[j];
+      sample_x[i] = batch_sample_x[j];
+      sample_y[i] = batch_sample_y[j];
+      potentials[i] = batch_potentials[j];
+      stale[i] = 0;
+      update_color(i);
+    }
+  });
+
+  return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "Position.hpp"
+#include "Symmetry.hpp"
+#include "field.hpp"
+#include <Color.hpp>
+#include <Rectangle.hpp>
+#include <Vector2.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Large set of probes stored as parallel arrays
+ *
+ * Counterpart of `Probe` for dense probe grids: motions are kept by value,
+ * positions, samples and colors in contiguous arrays, and the field is
+ * evaluated for all probes in one batch. Only probes within the given bounds
+ * are sampled and drawn, the rest keeps a stale sample until it gets back in.
+ */
+class ProbeField {
+public:
+  ProbeField() = default;
+  explicit ProbeField(const float length) : length(length) {}
+
+  void clear();
+  void reserve(const size_t count);
+  void push_back(const Position &motion, const raylib::Color &color);
+  /// Replace the probe at index `i`, only its sample gets recomputed
+  void
+  set(const size_t i, const Position &motion, const raylib::Color &color);
+
+  /**
+   * @brief Move the probes and sample the field in their positions
+   *
+   * Only probes inside `bounds` are sampled. If none of the probes move and
+   * the field is the same as in the previous update, only the probes that
+   * were added, replaced or got into the bounds since then are sampled.
+   * Probes that are images of each other under the `symmetry` of the sources
+   * share a single evaluation.
+   *
+   * @return Whether any sample changed
+   */
+  bool update(
+      const float timeDelta,
+      const double elapsedTime,
+      const field::Sources &sources,
+      const raylib::Rectangle &bounds,
+      const Symmetry &symmetry = {}
+  );
+
+  size_t size() const { return motions.size(); }
+
+  raylib::Vector2 position(const size_t i) const { return {x[i], y[i]}; }
+  raylib::Vector2 sample(const size_t i) const {
+    return {sample_x[i], sample_y[i]};
+  }
+  float sample_potencial(const size_t i) const { return potentials[i]; }
+  raylib::Color color(const size_t i) const { return colors[i]; }
+  bool visible(const size_t i) const { return _visible[i]; }
+
+  /// Length of the drawn arrows
+  float length = 50.f;
+
+private:
+  void update_color(const size_t i);
+
+  std::vector<Position> motions{};
+  std::vector<raylib::Color> base_colors{};
+
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> sample_x{};
+  std::vector<float> sample_y{};
+  std::vector<float> potentials{};
+  std::vector<raylib::Color> colors{};
+
+  size_t moving = 0;
+  field::Sources evaluated_sources{};
+  std::vector<uint8_t> stale{};
+  std::vector<uint8_t> _visible{};
+
+  // Gathered stale probes in the bounds, sampled as one batch
+  std::vector<size_t> batch{};
+  std::vector<float> batch_x{};
+  std::vector<float> batch_y{};
+  std::vector<float> batch_sample_x{};
+  std::vector<float> batch_sample_y{};
+  std::vector<float> batch_potentials{};
+  Orbits orbits{};
+  std::vector<float> orbit_sample_x{};
+  std::vector<float> orbit_sample_y{};
+  std::vector<float> orbit_potentials{};
+};
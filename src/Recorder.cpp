@@ -0,0 +1,216 @@
+#include "Recorder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t VERSION = 1;
+constexpr char MAGIC[8] = {'E', 'L', 'V', 'Z', 'R', 'E', 'C', '\0'};
+constexpr char LAYOUT[] = "time:f64,probe:u32,potential:f32,e_x:f32,e_y:f32";
+
+constexpr size_t ROW_SIZE =
+    sizeof(double) + sizeof(uint32_t) + 3 * sizeof(float);
+constexpr size_t BLOCK_SIZE = Recorder::BLOCK_ROWS * ROW_SIZE;
+
+// Offsets of the columns within a block
+constexpr size_t TIME_OFFSET = 0;
+constexpr size_t PROBE_OFFSET =
+    TIME_OFFSET + Recorder::BLOCK_ROWS * sizeof(double);
+constexpr size_t POTENTIAL_OFFSET =
+    PROBE_OFFSET + Recorder::BLOCK_ROWS * sizeof(uint32_t);
+constexpr size_t E_X_OFFSET =
+    POTENTIAL_OFFSET + Recorder::BLOCK_ROWS * sizeof(float);
+constexpr size_t E_Y_OFFSET = E_X_OFFSET + Recorder::BLOCK_ROWS * sizeof(float);
+
+/// Blocks mapped at once
+constexpr size_t WINDOW_BLOCKS = 16;
+/// Blocks the file is grown by at once
+constexpr size_t GROWTH_BLOCKS = 64;
+
+static_assert(sizeof(Recorder::Header) <= Recorder::HEADER_SIZE);
+static_assert(sizeof(LAYOUT) <= sizeof(Recorder::Header::layout));
+
+template <typename T>
+void copy_column(
+    std::byte *block,
+    const size_t column_offset,
+    const size_t row,
+    const std::vector<T> &values,
+    const size_t start,
+    const size_t count
+) {
+  std::memcpy(
+      block + column_offset + row * sizeof(T),
+      values.data() + start,
+      count * sizeof(T)
+  );
+}
+
+} // namespace
+
+void Recorder::Columns::clear() {
+  time.clear();
+  probe.clear();
+  potential.clear();
+  e_x.clear();
+  e_y.clear();
+}
+
+Recorder::Recorder(const std::string &path) : file(path) {
+  if (!file.is_open())
+    return;
+
+  if (!write_header()) {
+    file.close();
+    return;
+  }
+  worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+Recorder::~Recorder() {
+  if (worker.joinable()) {
+    worker.request_stop();
+    worker.join();
+  }
+
+  close();
+}
+
+void Recorder::append(
+    const std::span<const double> times,
+    const uint32_t probe,
+    const std::span<const float> potentials,
+    const std::span<const float> e_x,
+    const std::span<const float> e_y
+) {
+  if (!is_open() || failed)
+    return;
+
+  {
+    std::scoped_lock lock{mutex};
+    pending.time.insert(pending.time.end(), times.begin(), times.end());
+    pending.probe.insert(pending.probe.end(), times.size(), probe);
+    pending.potential.insert(
+        pending.potential.end(), potentials.begin(), potentials.end()
+    );
+    pending.e_x.insert(pending.e_x.end(), e_x.begin(), e_x.end());
+    pending.e_y.insert(pending.e_y.end(), e_y.begin(), e_y.end());
+  }
+  condition.notify_one();
+}
+
+void Recorder::run(std::stop_token stop) {
+  while (true) {
+    {
+      std::unique_lock lock{mutex};
+      condition.wait(lock, stop, [this] { return !pending.empty(); });
+
+      // Stopped, with everything written
+      if (pending.empty())
+        return;
+
+      std::swap(pending, writing);
+    }
+
+    write(writing);
+    writing.clear();
+  }
+}
+
+void Recorder::write(const Columns &columns) {
+  size_t start = 0;
+
+  while (start < columns.size() && !failed) {
+    const auto block = static_cast<size_t>(rows / BLOCK_ROWS);
+    const auto row = static_cast<size_t>(rows % BLOCK_ROWS);
+
+    if (window == nullptr || block < window_first ||
+        block >= window_first + WINDOW_BLOCKS)
+      map_window(block);
+
+    if (window == nullptr)
+      return;
+
+    // Copy the run of rows, that fits into the current block
+    const auto count = std::min(columns.size() - start, BLOCK_ROWS - row);
+    auto *data = window + (block - window_first) * BLOCK_SIZE;
+
+    copy_column(data, TIME_OFFSET, row, columns.time, start, count);
+    copy_column(data, PROBE_OFFSET, row, columns.probe, start, count);
+    copy_column(data, POTENTIAL_OFFSET, row, columns.potential, start, count);
+    copy_column(data, E_X_OFFSET, row, columns.e_x, start, count);
+    copy_column(data, E_Y_OFFSET, row, columns.e_y, start, count);
+
+    start += count;
+    rows += count;
+  }
+
+  write_header();
+}
+
+void Recorder::map_window(const size_t block) {
+  file.unmap();
+  window = nullptr;
+
+  const auto needed = HEADER_SIZE + (block + WINDOW_BLOCKS) * BLOCK_SIZE;
+  if (file_size < needed) {
+    const auto new_size =
+        std::max(needed, file_size + GROWTH_BLOCKS * BLOCK_SIZE);
+    // Without the space really allocated, a write to the mapping of a
+    // missing page would kill the process
+    if (!file.reserve(new_size)) {
+      fail("Failed to grow the recording");
+      return;
+    }
+    file_size = new_size;
+  }
+
+  window =
+      file.map(HEADER_SIZE + block * BLOCK_SIZE, WINDOW_BLOCKS * BLOCK_SIZE);
+  if (window == nullptr) {
+    fail("Failed to map the recording");
+    return;
+  }
+
+  window_first = block;
+}
+
+bool Recorder::write_header() {
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.block_rows = BLOCK_ROWS;
+  header.rows = rows;
+  header.header_size = HEADER_SIZE;
+  header.block_size = BLOCK_SIZE;
+  std::memcpy(header.layout, LAYOUT, sizeof(LAYOUT));
+
+  if (!file.write(0, &header, sizeof(header))) {
+    fail("Failed to write the header of the recording");
+    return false;
+  }
+  return true;
+}
+
+void Recorder::fail(const char *what) {
+  std::cerr << what << ": " << file.error() << ", recording stopped"
+            << std::endl;
+  failed = true;
+}
+
+void Recorder::close() {
+  if (!is_open())
+    return;
+
+  file.unmap();
+  window = nullptr;
+
+  // Drop the preallocated space after the last block
+  const auto blocks = (rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+  if (!file.truncate(HEADER_SIZE + blocks * BLOCK_SIZE))
+    fail("Failed to truncate the recording");
+  write_header();
+
+  file.close();
+}
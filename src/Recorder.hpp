@@ -0,0 +1,105 @@
+#pragma once
+#include "MappedFile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Records time series of probes into a memory-mapped columnar file
+ *
+ * The file starts with a `Header` page, followed by blocks of `BLOCK_ROWS`
+ * rows. Each block stores its columns one after another:
+ *
+ * - `time` as `f64`, in seconds of simulation time
+ * - `probe` as `u32`, index of the user probe
+ * - `potential`, `e_x` and `e_y` as `f32`
+ *
+ * Only the first `Header::rows` rows are valid, the rest of the last block is
+ * unspecified. All values are little-endian.
+ *
+ * Samples are only queued on the calling thread, a background thread copies
+ * them into the file. The file is grown in large preallocated steps and only a
+ * small window of it is mapped at a time, so memory use stays constant no
+ * matter how long the recording runs.
+ */
+class Recorder {
+public:
+  static constexpr size_t BLOCK_ROWS = 4096;
+  static constexpr size_t HEADER_SIZE = 4096;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_rows;
+    uint64_t rows;
+    uint32_t header_size;
+    uint32_t block_size;
+    /// Columns of a block as `name:type`, separated by commas
+    char layout[224];
+  };
+
+  explicit Recorder(const std::string &path);
+  ~Recorder();
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  bool is_open() const { return file.is_open(); }
+
+  /// Queue samples of a single probe, one row per time
+  void append(
+      const std::span<const double> times,
+      const uint32_t probe,
+      const std::span<const float> potentials,
+      const std::span<const float> e_x,
+      const std::span<const float> e_y
+  );
+
+private:
+  struct Columns {
+    std::vector<double> time{};
+    std::vector<uint32_t> probe{};
+    std::vector<float> potential{};
+    std::vector<float> e_x{};
+    std::vector<float> e_y{};
+
+    size_t size() const { return time.size(); }
+    bool empty() const { return time.empty(); }
+    void clear();
+  };
+
+  void run(std::stop_token stop);
+  void write(const Columns &columns);
+  void map_window(const size_t block);
+  /// @return False when the header couldn't be written
+  bool write_header();
+  /// Report the last error of the file and stop recording
+  void fail(const char *what);
+  void close();
+
+  // Owned by the worker thread, until it's joined
+  MappedFile file{};
+  uint64_t rows = 0;
+  size_t file_size = 0;
+  std::byte *window = nullptr;
+  size_t window_first = 0;
+  Columns writing{};
+
+  /// Set by the worker thread, once the file can't be written anymore
+  std::atomic<bool> failed = false;
+
+  // Shared, guarded by `mutex`
+  std::mutex mutex{};
+  std::condition_variable_any condition{};
+  Columns pending{};
+
+  // Declared last, so it's started after everything else is initialized
+  std::jthread worker{};
+};
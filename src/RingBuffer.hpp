@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Double-ended queue with a fixed capacity
+ *
+ * Storage is allocated once in the constructor, pushing and popping on either
+ * end never allocates.
+ */
+template <typename T> class RingBuffer {
+public:
+  RingBuffer() = default;
+  explicit RingBuffer(const size_t capacity) : buffer(capacity) {}
+
+  size_t capacity() const { return buffer.size(); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == buffer.size(); }
+
+  void clear() {
+    start = 0;
+    count = 0;
+  }
+
+  /// The buffer must not be full
+  void push_back(const T &value) {
+    buffer[index(count)] = value;
+    ++count;
+  }
+
+  /// The buffer must not be empty
+  void pop_front() {
+    start = index(1);
+    --count;
+  }
+
+  /// The buffer must not be empty
+  void pop_back() { --count; }
+
+  /// `0` is the oldest element
+  const T &operator[](const size_t i) const { return buffer[index(i)]; }
+  T &operator[](const size_t i) { return buffer[index(i)]; }
+
+  const T &front() const { return (*this)[0]; }
+  const T &back() const { return (*this)[count - 1]; }
+
+private:
+  size_t index(const size_t i) const {
+    auto j = start + i;
+    return j >= buffer.size() ? j - buffer.size() : j;
+  }
+
+  std::vector<T> buffer{};
+  size_t start = 0;
+  size_t count = 0;
+};
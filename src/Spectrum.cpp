@@ -0,0 +1,247 @@
+#include "Spectrum.hpp"
+#include "defs.hpp"
+#include <Functions.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <ranges>
+#include <utility>
+
+namespace ranges = std::ranges;
+
+static_assert(std::has_single_bit(SPECTRUM_WINDOW));
+static_assert(SPECTRUM_BINS <= SPECTRUM_WINDOW / 2);
+
+Spectrum::Spectrum(
+    const raylib::Vector2 position,
+    const raylib::Vector2 size,
+    const raylib::Color background_color,
+    const raylib::Color accent_color
+)
+    : position(position), size(size), background_color(background_color),
+      accent_color(accent_color) {
+  // Rotation by one sample for each bin
+  twiddles.resize(SPECTRUM_BINS);
+  for (size_t k = 0; k < SPECTRUM_BINS; ++k) {
+    twiddles[k] = std::polar(
+        1.0, 2.0 * std::numbers::pi * k / static_cast<double>(SPECTRUM_WINDOW)
+    );
+  }
+  fft_buffer.resize(SPECTRUM_WINDOW);
+
+  max_frequency_text = std::format(
+      "{:.0f} Hz",
+      PLOT_SAMPLE_RATE * (SPECTRUM_BINS - 1) /
+          static_cast<float>(SPECTRUM_WINDOW)
+  );
+  max_frequency_width =
+      raylib::MeasureText(max_frequency_text, FONT_SIZE_SMALL);
+
+  worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void Spectrum::append(
+    const size_t probe, const std::span<const float> samples
+) {
+  {
+    std::scoped_lock lock{mutex};
+    if (pending.size() <= probe)
+      pending.resize(probe + 1);
+    auto &probe_samples = pending[probe];
+    probe_samples.insert(probe_samples.end(), samples.begin(), samples.end());
+    has_pending = true;
+  }
+  condition.notify_one();
+}
+
+void Spectrum::clear() {
+  front.clear();
+
+  {
+    std::scoped_lock lock{mutex};
+    for (auto &samples : pending) {
+      samples.clear();
+    }
+    finished.clear();
+    has_finished = false;
+    clear_requested = true;
+  }
+  condition.notify_one();
+}
+
+void Spectrum::slide(Channel &channel, const float sample) {
+  float oldest = 0.f;
+  if (channel.window.full()) {
+    oldest = channel.window.front();
+    channel.window.pop_front();
+  }
+  channel.window.push_back(sample);
+
+  // Drop the oldest sample, add the new one and shift the phase by a sample
+  const auto delta = static_cast<double>(sample - oldest);
+  for (size_t k = 0; k < SPECTRUM_BINS; ++k) {
+    channel.bins[k] = (channel.bins[k] + delta) * twiddles[k];
+  }
+
+  if (++channel.since_fft >= SPECTRUM_WINDOW)
+    transform(channel);
+}
+
+void Spectrum::transform(Channel &channel) {
+  // Window is zero padded in the front, until it fills up
+  const auto padding = SPECTRUM_WINDOW - channel.window.size();
+  for (size_t i = 0; i < SPECTRUM_WINDOW; ++i) {
+    fft_buffer[i] = i < padding ? 0.0 : channel.window[i - padding];
+  }
+
+  // Iterative radix-2 FFT, starting with the bit reversal permutation
+  for (size_t i = 1, j = 0; i < SPECTRUM_WINDOW; ++i) {
+    auto bit = SPECTRUM_WINDOW >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+
+    if (i < j)
+      std::swap(fft_buffer[i], fft_buffer[j]);
+  }
+
+  for (size_t length = 2; length <= SPECTRUM_WINDOW; length <<= 1) {
+    const auto step = std::polar(
+        1.0, -2.0 * std::numbers::pi / static_cast<double>(length)
+    );
+
+    for (size_t start = 0; start < SPECTRUM_WINDOW; start += length) {
+      std::complex<double> w = 1.0;
+      for (size_t i = 0; i < length / 2; ++i) {
+        const auto even = fft_buffer[start + i];
+        const auto odd = fft_buffer[start + i + length / 2] * w;
+        fft_buffer[start + i] = even + odd;
+        fft_buffer[start + i + length / 2] = even - odd;
+        w *= step;
+      }
+    }
+  }
+
+  std::copy_n(fft_buffer.begin(), SPECTRUM_BINS, channel.bins.begin());
+  channel.since_fft = 0;
+}
+
+void Spectrum::run(std::stop_token stop) {
+  while (true) {
+    auto clear_channels = false;
+
+    {
+      std::unique_lock lock{mutex};
+      condition.wait(lock, stop, [this] {
+        return has_pending || clear_requested;
+      });
+
+      if (stop.stop_requested())
+        return;
+
+      std::swap(pending, incoming);
+      has_pending = false;
+      clear_channels = std::exchange(clear_requested, false);
+    }
+
+    if (clear_channels)
+      channels.clear();
+
+    for (size_t probe = 0; probe < incoming.size(); ++probe) {
+      while (channels.size() <= probe) {
+        channels.push_back({
+            RingBuffer<float>(SPECTRUM_WINDOW),
+            std::vector<std::complex<double>>(SPECTRUM_BINS),
+        });
+      }
+
+      for (auto sample : incoming[probe]) {
+        slide(channels[probe], sample);
+      }
+      incoming[probe].clear();
+    }
+
+    // Amplitudes of the sinusoids in the signal
+    back.resize(channels.size());
+    for (size_t probe = 0; probe < channels.size(); ++probe) {
+      back[probe].resize(SPECTRUM_BINS);
+      for (size_t k = 0; k < SPECTRUM_BINS; ++k) {
+        back[probe][k] = static_cast<float>(
+            std::abs(channels[probe].bins[k]) * 2.0 / SPECTRUM_WINDOW
+        );
+      }
+    }
+
+    {
+      std::scoped_lock lock{mutex};
+      std::swap(back, finished);
+      has_finished = true;
+    }
+  }
+}
+
+void Spectrum::draw(const std::vector<raylib::Color> &probe_colors) {
+  {
+    std::scoped_lock lock{mutex};
+    if (has_finished) {
+      std::swap(front, finished);
+      has_finished = false;
+    }
+  }
+
+  auto border = raylib::Vector2{2.f, 2.f};
+  accent_color.DrawRectangle(position, size);
+  background_color.DrawRectangle(position + border, size - border * 2.f);
+
+  const auto left_edge = position.x + 2.f * border.x;
+  const auto right_edge = position.x + size.x - 2.f * border.x;
+  const auto top_edge = position.y + border.y + FONT_SIZE_SMALL;
+  const auto bottom_edge = position.y + size.y - border.y - FONT_SIZE_SMALL;
+
+  raylib::DrawText(
+      "Spectrum of the potential",
+      left_edge,
+      position.y + border.y,
+      FONT_SIZE_SMALL,
+      accent_color
+  );
+  raylib::DrawText(
+      "0 Hz", left_edge, bottom_edge, FONT_SIZE_SMALL, accent_color
+  );
+  raylib::DrawText(
+      max_frequency_text,
+      right_edge - max_frequency_width,
+      bottom_edge,
+      FONT_SIZE_SMALL,
+      accent_color
+  );
+
+  // DC component is left out, it would dwarf everything else
+  float max = 0.f;
+  for (const auto &amplitudes : front) {
+    for (size_t k = 1; k < amplitudes.size(); ++k) {
+      max = std::max(max, amplitudes[k]);
+    }
+  }
+
+  if (max == 0.f)
+    return;
+
+  const auto width = right_edge - left_edge;
+  const auto height = bottom_edge - top_edge;
+
+  for (auto [amplitudes, color] : ranges::zip_view(front, probe_colors)) {
+    for (size_t k = 1; k < amplitudes.size(); ++k) {
+      draw_buffer.emplace_back(
+          left_edge + width * (k - 1) / (SPECTRUM_BINS - 2),
+          bottom_edge - height * amplitudes[k] / max
+      );
+    }
+
+    color.DrawLineStrip(draw_buffer.data(), draw_buffer.size());
+    draw_buffer.clear();
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "RingBuffer.hpp"
+#include <Color.hpp>
+#include <Vector2.hpp>
+#include <complex>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Frequency content of the probe signals
+ *
+ * Every probe has a sliding DFT over the last `SPECTRUM_WINDOW` samples,
+ * updated per sample in O(`SPECTRUM_BINS`). To get rid of the rounding errors
+ * the sliding DFT accumulates, the bins are recomputed by a full FFT over the
+ * window once per window length.
+ *
+ * Samples are only queued on the calling thread, the analysis runs on a
+ * background thread and `draw` shows its newest finished result.
+ */
+class Spectrum {
+public:
+  Spectrum(
+      const raylib::Vector2 position,
+      const raylib::Vector2 size,
+      const raylib::Color background_color,
+      const raylib::Color accent_color
+  );
+
+  Spectrum(const Spectrum &) = delete;
+  Spectrum &operator=(const Spectrum &) = delete;
+
+  /// Queue new samples of a probe, sampled at `PLOT_SAMPLE_RATE`
+  void append(const size_t probe, const std::span<const float> samples);
+  void clear();
+
+  void draw(const std::vector<raylib::Color> &probe_colors);
+  void
+  resize(const raylib::Vector2 new_position, const raylib::Vector2 new_size) {
+    position = new_position;
+    size = new_size;
+  }
+
+private:
+  struct Channel {
+    RingBuffer<float> window;
+    std::vector<std::complex<double>> bins;
+    size_t since_fft = 0;
+  };
+
+  void run(std::stop_token stop);
+  void slide(Channel &channel, const float sample);
+  void transform(Channel &channel);
+
+  raylib::Vector2 position;
+  raylib::Vector2 size;
+  raylib::Color background_color;
+  raylib::Color accent_color;
+
+  std::string max_frequency_text{};
+  int max_frequency_width = 0;
+
+  // Owned by the render thread
+  /// Amplitudes of the bins for each probe
+  std::vector<std::vector<float>> front{};
+  std::vector<raylib::Vector2> draw_buffer{};
+
+  // Shared, guarded by `mutex`
+  std::mutex mutex{};
+  std::condition_variable_any condition{};
+  std::vector<std::vector<float>> pending{};
+  bool has_pending = false;
+  bool clear_requested = false;
+  std::vector<std::vector<float>> finished{};
+  bool has_finished = false;
+
+  // Owned by the worker thread
+  std::vector<std::vector<float>> incoming{};
+  std::vector<Channel> channels{};
+  std::vector<std::vector<float>> back{};
+  std::vector<std::complex<double>> twiddles{};
+  std::vector<std::complex<double>> fft_buffer{};
+
+  // Declared last, so it's stopped and joined before the rest is destroyed
+  std::jthread worker{};
+};
@@ -0,0 +1,64 @@
+#include "Strengths.hpp"
+#include "defs.hpp"
+#include "parallel.hpp"
+#include <array>
+#include <string>
+
+namespace {
+const std::array<std::string, 1> VARIABLES = {"t"};
+} // namespace
+
+Strengths::Strengths(const std::span<Charge> charges) {
+  math::Compiler compiler{VARIABLES};
+
+  for (size_t i = 0; i < charges.size(); ++i) {
+    const auto *expression = charges[i].expression();
+    if (expression == nullptr) {
+      charges[i].update(0.f, 0.0);
+      continue;
+    }
+
+    // Equal expressions share their output, that's what groups them
+    const auto output = compiler.add(*expression);
+    if (groups.size() <= output)
+      groups.resize(output + 1);
+
+    groups[output].output = output;
+    groups[output].charges.push_back(static_cast<uint32_t>(i));
+  }
+
+  program = compiler.build();
+  values.resize(program.outputs());
+
+  for (const auto &group : groups) {
+    const auto period = compiler.period(group.output, 0);
+    _period = period && _period ? math::common_period(*_period, *period)
+                                : std::nullopt;
+  }
+}
+
+void Strengths::update(
+    const double elapsedTime, const std::span<Charge> charges
+) {
+  if (groups.empty())
+    return;
+
+  const std::array variables{static_cast<float>(elapsedTime)};
+  program.run(variables, values);
+
+  for (const auto &group : groups) {
+    const auto value = values[group.output];
+
+    auto scatter = [&](size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        charges[group.charges[i]].update(value);
+      }
+    };
+
+    if (group.charges.size() >= STRENGTH_PARALLEL_GROUP) {
+      parallel::for_each(group.charges.size(), scatter);
+    } else {
+      scatter(0, group.charges.size());
+    }
+  }
+}
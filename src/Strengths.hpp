@@ -0,0 +1,44 @@
+#pragma once
+#include "Charge.hpp"
+#include "MathEval.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Updates the strengths of all charges at once
+ *
+ * All strength expressions of a scenario are compiled into a single program,
+ * so constant parts are folded once and subexpressions shared between charges,
+ * like `sin(pi/2t)` in `1+sin(pi/2t)` and `-sin(pi/2t)`, are only evaluated
+ * once per frame.
+ *
+ * Charges are grouped by their expression, each group gets its value from a
+ * single output of the program. Charges with constant strengths are set up
+ * once and never touched again.
+ */
+class Strengths {
+public:
+  /// @throws parser_exception when an expression isn't valid
+  explicit Strengths(const std::span<Charge> charges);
+
+  void update(const double elapsedTime, const std::span<Charge> charges);
+
+  /// Common period of all strengths, 0 when they're all constant and
+  /// `nullopt` when there's none
+  std::optional<double> period() const { return _period; }
+
+private:
+  struct Group {
+    size_t output;
+    std::vector<uint32_t> charges;
+  };
+
+  math::Program program{};
+  std::vector<Group> groups{};
+  /// Value of each output of the program
+  std::vector<float> values{};
+  std::optional<double> _period = 0.0;
+};
@@ -0,0 +1,520 @@
+#include "Symmetry.hpp"
+#include "defs.hpp"
+#include "field.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numbers>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+constexpr float TAU = 2.f * std::numbers::pi_v<float>;
+/// Images of points closer than this share a representative, in world units
+constexpr float ORBIT_TOLERANCE = 1e-2f;
+/// Images closer than this to a grid point, relative to the step, are copied
+/// from it instead of interpolated
+constexpr float GRID_SNAP = 1e-3f;
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+/// Marks images outside of a grid, that get their own representative
+constexpr uint32_t OUTSIDE = 1u << 31;
+
+/**
+ * @brief Points bucketed into cells the size of a tolerance
+ *
+ * All points within the tolerance of a point are in its cell or one of the
+ * eight around it.
+ */
+class PointLookup {
+public:
+  explicit PointLookup(const float tolerance) : tolerance(tolerance) {}
+
+  void insert(const raylib::Vector2 point, const uint32_t value) {
+    cells.emplace(key(cell(point.x), cell(point.y)), Entry{point, value});
+  }
+
+  /// Value of a point within the tolerance of `point`, which `accept`s it
+  std::optional<uint32_t> find(
+      const raylib::Vector2 point,
+      const std::function<bool(uint32_t)> &accept
+  ) const {
+    const auto column = cell(point.x);
+    const auto row = cell(point.y);
+
+    for (int64_t dy = -1; dy <= 1; ++dy) {
+      for (int64_t dx = -1; dx <= 1; ++dx) {
+        const auto [first, last] =
+            cells.equal_range(key(column + dx, row + dy));
+        for (auto it = first; it != last; ++it) {
+          const auto &entry = it->second;
+          if (entry.point.Distance(point) <= tolerance && accept(entry.value))
+            return entry.value;
+        }
+      }
+    }
+
+    return std::nullopt;
+  }
+
+private:
+  struct Entry {
+    raylib::Vector2 point;
+    uint32_t value;
+  };
+
+  int64_t cell(const float coordinate) const {
+    return static_cast<int64_t>(std::floor(coordinate / tolerance));
+  }
+  static uint64_t key(const int64_t column, const int64_t row) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(column)) << 32) |
+           static_cast<uint32_t>(row);
+  }
+
+  float tolerance;
+  std::unordered_multimap<uint64_t, Entry> cells{};
+};
+
+Symmetry::Transform rotation(const float angle, const float sign) {
+  const auto c = std::cos(angle);
+  const auto s = std::sin(angle);
+  return {{c, s}, {-s, c}, sign};
+}
+
+Symmetry::Transform reflection(const float axis, const float sign) {
+  const auto c = std::cos(2.f * axis);
+  const auto s = std::sin(2.f * axis);
+  return {{c, s}, {s, -c}, sign};
+}
+
+float angle(const raylib::Vector2 vector) {
+  return std::atan2(vector.y, vector.x);
+}
+
+/// Angle wrapped to [0, 2pi)
+float wrap(const float angle) {
+  return angle - TAU * std::floor(angle / TAU);
+}
+
+} // namespace
+
+Symmetry::Symmetry(
+    const raylib::Vector2 center,
+    const float axis,
+    const size_t rotations,
+    const float rotation_sign,
+    const bool reflections,
+    const float reflection_sign
+)
+    : center(center), axis(axis), rotations(rotations),
+      reflections(reflections) {
+  const auto sector = TAU / static_cast<float>(rotations);
+
+  transforms.clear();
+  auto sign = 1.f;
+  for (size_t j = 0; j < rotations; ++j) {
+    transforms.push_back(rotation(static_cast<float>(j) * sector, sign));
+    sign *= rotation_sign;
+  }
+
+  if (!reflections)
+    return;
+
+  // Reflection `j` is rotation `j` after the reflection about the far edge of
+  // the domain, which is the rotation by a sector after the one about `axis`
+  sign = reflection_sign * rotation_sign;
+  for (size_t j = 0; j < rotations; ++j) {
+    transforms.push_back(reflection(
+        axis + static_cast<float>(j + 1) * sector / 2.f, sign
+    ));
+    sign *= rotation_sign;
+  }
+}
+
+Symmetry Symmetry::detect(const std::span<const Charge> charges) {
+  if (charges.empty() || !field::background().empty())
+    return {};
+
+  const auto count = charges.size();
+
+  // Charges can be mapped onto each other, when they have the same kind of
+  // strength function. Their signs say whether it's negated.
+  std::map<std::pair<std::string, float>, uint32_t> kinds{};
+  std::vector<uint32_t> kind(count);
+  std::vector<float> sign(count);
+  raylib::Vector2 center{};
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto *expression = charges[i].expression();
+    const auto value = expression != nullptr ? charges[i].modifier()
+                                             : charges[i].strength_at(0.0);
+    const auto key = std::pair{
+        expression != nullptr ? *expression : std::string{}, std::abs(value)
+    };
+
+    kind[i] = kinds.try_emplace(key, static_cast<uint32_t>(kinds.size()))
+                  .first->second;
+    sign[i] = value > 0.f ? 1.f : value < 0.f ? -1.f : 0.f;
+    center += charges[i].position();
+  }
+  center /= static_cast<float>(count);
+
+  PointLookup lookup{SYMMETRY_TOLERANCE};
+  for (size_t i = 0; i < count; ++i) {
+    lookup.insert(charges[i].position(), static_cast<uint32_t>(i));
+  }
+
+  auto maps_onto = [&](const Transform &transform) {
+    for (size_t i = 0; i < count; ++i) {
+      const auto image =
+          center + transform(charges[i].position() - center);
+      const auto match = lookup.find(image, [&](const uint32_t j) {
+        return kind[j] == kind[i] && sign[j] == transform.sign * sign[i];
+      });
+      if (!match)
+        return false;
+    }
+    return true;
+  };
+
+  // Highest order first. Negating rotations need an even order, to come back
+  // to the identity.
+  size_t rotation_order = 1;
+  auto rotation_sign = 1.f;
+  for (auto order = SYMMETRY_MAX_ROTATION; order >= 2 && rotation_order == 1;
+       --order) {
+    for (const auto candidate_sign : {1.f, -1.f}) {
+      if (candidate_sign < 0.f && order % 2 != 0)
+        continue;
+
+      const auto step = TAU / static_cast<float>(order);
+      if (maps_onto(rotation(step, candidate_sign))) {
+        rotation_order = order;
+        rotation_sign = candidate_sign;
+        break;
+      }
+    }
+  }
+
+  // The farthest charge is reflected onto one at the same distance, the axis
+  // halves the angle between them. Axes repeat every half of a sector, so
+  // only the charges in the first sector after it are candidates.
+  const auto farthest = static_cast<size_t>(std::distance(
+      charges.begin(),
+      std::ranges::max_element(charges, {}, [&](const Charge &charge) {
+        return charge.position().Distance(center);
+      })
+  ));
+  const auto radius = charges[farthest].position().Distance(center);
+  const auto first_angle = angle(charges[farthest].position() - center);
+  const auto sector = TAU / static_cast<float>(rotation_order);
+
+  for (size_t j = 0; j < count; ++j) {
+    const auto offset = charges[j].position() - center;
+    if (kind[j] != kind[farthest] ||
+        std::abs(offset.Length() - radius) > SYMMETRY_TOLERANCE)
+      continue;
+
+    const auto delta = wrap(angle(offset) - first_angle);
+    if (delta >= sector)
+      continue;
+
+    const auto axis = first_angle + delta / 2.f;
+    for (const auto candidate_sign : {1.f, -1.f}) {
+      if (sign[j] != candidate_sign * sign[farthest] ||
+          !maps_onto(reflection(axis, candidate_sign)))
+        continue;
+
+      return Symmetry(
+          center, axis, rotation_order, rotation_sign, true, candidate_sign
+      );
+    }
+  }
+
+  if (rotation_order == 1)
+    return {};
+
+  return Symmetry(
+      center, first_angle, rotation_order, rotation_sign, false, 1.f
+  );
+}
+
+Symmetry::Reduced Symmetry::reduce(const raylib::Vector2 point) const {
+  const auto offset = point - center;
+  if (trivial() || (offset.x == 0.f && offset.y == 0.f))
+    return {point, 0};
+
+  const auto sector = TAU / static_cast<float>(rotations);
+  const auto relative = wrap(angle(offset) - axis);
+  const auto j = std::min(
+      static_cast<size_t>(relative / sector), rotations - 1
+  );
+
+  auto remainder = relative - static_cast<float>(j) * sector;
+  auto element = static_cast<uint32_t>(j);
+  if (reflections && remainder > sector / 2.f) {
+    remainder = sector - remainder;
+    element = static_cast<uint32_t>(rotations + j);
+  }
+
+  const auto reduced_angle = axis + remainder;
+  const raylib::Vector2 direction{
+      std::cos(reduced_angle), std::sin(reduced_angle)
+  };
+  return {center + direction * offset.Length(), element};
+}
+
+uint32_t Orbits::add(const raylib::Vector2 point) {
+  _x.push_back(point.x);
+  _y.push_back(point.y);
+  return static_cast<uint32_t>(_x.size() - 1);
+}
+
+void Orbits::assign(
+    const Symmetry &symmetry,
+    const std::span<const float> x,
+    const std::span<const float> y
+) {
+  if (assigned && symmetry == assigned_symmetry &&
+      std::ranges::equal(x, assigned_x) && std::ranges::equal(y, assigned_y))
+    return;
+
+  assigned = true;
+  assigned_symmetry = symmetry;
+  assigned_x.assign(x.begin(), x.end());
+  assigned_y.assign(y.begin(), y.end());
+
+  transforms.clear();
+  for (uint32_t element = 0; element < symmetry.order(); ++element) {
+    transforms.push_back(symmetry.transform(element));
+  }
+
+  images.clear();
+  _x.clear();
+  _y.clear();
+
+  PointLookup lookup{ORBIT_TOLERANCE};
+  for (size_t i = 0; i < x.size(); ++i) {
+    const auto reduced = symmetry.reduce({x[i], y[i]});
+
+    auto source = symmetry.trivial()
+                      ? std::nullopt
+                      : lookup.find(reduced.point, [](uint32_t) {
+                          return true;
+                        });
+    if (!source) {
+      source = add(reduced.point);
+      lookup.insert(reduced.point, *source);
+    }
+
+    images.push_back(
+        {{*source, *source, *source, *source},
+         {1.f, 0.f, 0.f, 0.f},
+         reduced.element}
+    );
+  }
+}
+
+void Orbits::assign_grid(
+    const Symmetry &symmetry,
+    const raylib::Vector2 origin,
+    const raylib::Vector2 step,
+    const size_t width,
+    const size_t height
+) {
+  assigned = false;
+
+  transforms.clear();
+  for (uint32_t element = 0; element < symmetry.order(); ++element) {
+    transforms.push_back(symmetry.transform(element));
+  }
+
+  const auto count = width * height;
+  images.resize(count);
+  _x.clear();
+  _y.clear();
+  grid_sources.assign(count, NONE);
+
+  auto grid_point = [&](const size_t column, const size_t row) {
+    return raylib::Vector2{
+        origin.x + step.x * static_cast<float>(column),
+        origin.y + step.y * static_cast<float>(row)
+    };
+  };
+
+  // Cell of the grid along one axis and the position within it, snapped to
+  // its edges
+  auto split = [](const float position, const size_t size) {
+    if (size < 2)
+      return std::pair<size_t, float>{0, 0.f};
+
+    const auto cell = std::min(static_cast<size_t>(position), size - 2);
+    auto fraction = position - static_cast<float>(cell);
+    if (fraction < GRID_SNAP)
+      fraction = 0.f;
+    if (fraction > 1.f - GRID_SNAP)
+      fraction = 1.f;
+    return std::pair{cell, fraction};
+  };
+
+  // First find the grid points, that have to be evaluated. `NONE` marks the
+  // ones, that aren't, until they get their representatives.
+  std::vector<raylib::Vector2> outside{};
+  for (size_t row = 0; row < height; ++row) {
+    for (size_t column = 0; column < width; ++column) {
+      const auto i = row * width + column;
+      const auto reduced = symmetry.reduce(grid_point(column, row));
+      auto &image = images[i];
+
+      if (reduced.element == 0) {
+        image = {{0, 0, 0, 0}, {1.f, 0.f, 0.f, 0.f}, 0};
+        grid_sources[i] = 0;
+        continue;
+      }
+
+      const auto position = (reduced.point - origin) / step;
+      const auto inside = position.x >= 0.f && position.y >= 0.f &&
+                          position.x <= static_cast<float>(width - 1) &&
+                          position.y <= static_cast<float>(height - 1);
+      if (!inside) {
+        const auto index = static_cast<uint32_t>(outside.size()) | OUTSIDE;
+        outside.push_back(reduced.point);
+        image = {
+            {index, index, index, index},
+            {1.f, 0.f, 0.f, 0.f},
+            reduced.element
+        };
+        continue;
+      }
+
+      const auto [cell_x, tx] = split(position.x, width);
+      const auto [cell_y, ty] = split(position.y, height);
+      const auto corner = static_cast<uint32_t>(cell_y * width + cell_x);
+      const auto right = std::min(cell_x + 1, width - 1);
+      const auto below = std::min(cell_y + 1, height - 1);
+      image = {
+          {corner,
+           static_cast<uint32_t>(cell_y * width + right),
+           static_cast<uint32_t>(below * width + cell_x),
+           static_cast<uint32_t>(below * width + right)},
+          {(1.f - tx) * (1.f - ty), tx * (1.f - ty), (1.f - tx) * ty, tx * ty},
+          reduced.element
+      };
+
+      for (size_t k = 0; k < 4; ++k) {
+        if (image.weights[k] > 0.f)
+          grid_sources[image.sources[k]] = 0;
+      }
+    }
+  }
+
+  // Evaluated grid points are their own representatives, in the order of the
+  // grid, followed by the images outside of it
+  for (size_t i = 0; i < count; ++i) {
+    if (grid_sources[i] == NONE)
+      continue;
+
+    grid_sources[i] = add(grid_point(i % width, i / width));
+    images[i] = {
+        {grid_sources[i], grid_sources[i], grid_sources[i], grid_sources[i]},
+        {1.f, 0.f, 0.f, 0.f},
+        0
+    };
+  }
+
+  const auto first_outside = static_cast<uint32_t>(_x.size());
+  for (const auto point : outside) {
+    add(point);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    if (grid_sources[i] != NONE)
+      continue;
+
+    auto &image = images[i];
+    auto resolve = [&](const uint32_t source) {
+      return (source & OUTSIDE) ? first_outside + (source & ~OUTSIDE)
+                                : grid_sources[source];
+    };
+
+    // Corners without weight can be left unevaluated, they only need a valid
+    // index
+    const auto used = static_cast<size_t>(std::distance(
+        image.weights.begin(),
+        std::ranges::find_if(image.weights, [](float w) { return w > 0.f; })
+    ));
+    const auto fallback = resolve(image.sources[used]);
+    for (size_t k = 0; k < 4; ++k) {
+      image.sources[k] =
+          image.weights[k] > 0.f ? resolve(image.sources[k]) : fallback;
+    }
+  }
+}
+
+void Orbits::expand(
+    const std::span<const float> values,
+    const std::span<float> out,
+    const size_t stride
+) const {
+  auto expand_range = [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      const auto &image = images[i];
+      const auto sign = transforms[image.element].sign;
+
+      for (size_t s = 0; s < stride; ++s) {
+        auto value = 0.f;
+        for (size_t k = 0; k < 4; ++k) {
+          value += image.weights[k] * values[image.sources[k] * stride + s];
+        }
+        out[i * stride + s] = sign * value;
+      }
+    }
+  };
+
+  if (images.size() * stride >= SYMMETRY_PARALLEL_POINTS) {
+    parallel::for_each(images.size(), expand_range);
+  } else {
+    expand_range(0, images.size());
+  }
+}
+
+void Orbits::expand(
+    const std::span<const float> values_x,
+    const std::span<const float> values_y,
+    const std::span<float> out_x,
+    const std::span<float> out_y,
+    const size_t stride
+) const {
+  auto expand_range = [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      const auto &image = images[i];
+      const auto &transform = transforms[image.element];
+
+      for (size_t s = 0; s < stride; ++s) {
+        raylib::Vector2 value{};
+        for (size_t k = 0; k < 4; ++k) {
+          const auto source = image.sources[k] * stride + s;
+          value +=
+              raylib::Vector2{values_x[source], values_y[source]} *
+              image.weights[k];
+        }
+
+        const auto mapped = transform(value) * transform.sign;
+        out_x[i * stride + s] = mapped.x;
+        out_y[i * stride + s] = mapped.y;
+      }
+    }
+  };
+
+  if (images.size() * stride >= SYMMETRY_PARALLEL_POINTS) {
+    parallel::for_each(images.size(), expand_range);
+  } else {
+    expand_range(0, images.size());
+  }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "Charge.hpp"
+#include <Vector2.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Rotations and reflections, that map the charges onto themselves
+ *
+ * Looks for discrete rotations about the centroid of the charges of order up
+ * to `SYMMETRY_MAX_ROTATION` and for reflections about an axis through it.
+ * Charges have to land on charges with the same strength function within
+ * `SYMMETRY_TOLERANCE`, or with the negated one. In the latter case the
+ * potential and the field in the image change their sign, like on the two
+ * sides of a dipole.
+ *
+ * The whole plane is covered by the images of a single fundamental domain, a
+ * sector between the centroid and two axes, so fields only need evaluating in
+ * there.
+ */
+class Symmetry {
+public:
+  /// Linear part of an element of the symmetry group, with its sign
+  struct Transform {
+    raylib::Vector2 x_axis{1.f, 0.f};
+    raylib::Vector2 y_axis{0.f, 1.f};
+    /// The potential and the field are multiplied by it in the image
+    float sign = 1.f;
+
+    raylib::Vector2 operator()(const raylib::Vector2 vector) const {
+      return x_axis * vector.x + y_axis * vector.y;
+    }
+
+    bool operator==(const Transform &) const = default;
+  };
+
+  /// Point in the fundamental domain and the element mapping it back
+  struct Reduced {
+    raylib::Vector2 point;
+    uint32_t element;
+  };
+
+  /// Only the identity
+  Symmetry() = default;
+
+  /// Largest symmetry of the charges and the background, trivial when the
+  /// background isn't empty
+  static Symmetry detect(const std::span<const Charge> charges);
+
+  /// Number of elements, the fundamental domain is this fraction of the plane
+  size_t order() const { return transforms.size(); }
+  bool trivial() const { return order() == 1; }
+
+  /// Map a point into the fundamental domain, the identity keeps the ones
+  /// already in there
+  Reduced reduce(const raylib::Vector2 point) const;
+  const Transform &transform(const uint32_t element) const {
+    return transforms[element];
+  }
+
+  bool operator==(const Symmetry &) const = default;
+
+private:
+  Symmetry(
+      const raylib::Vector2 center,
+      const float axis,
+      const size_t rotations,
+      const float rotation_sign,
+      const bool reflections,
+      const float reflection_sign
+  );
+
+  raylib::Vector2 center{};
+  /// Angle of the first edge of the fundamental domain
+  float axis = 0.f;
+  size_t rotations = 1;
+  bool reflections = false;
+  /// Rotations first, then the reflections composed with them
+  std::vector<Transform> transforms{Transform{}};
+};
+
+/**
+ * @brief Points of a batch, reduced by a symmetry to the ones evaluated
+ *
+ * Each point is an image of a few representatives, that all lie in the
+ * fundamental domain. Values computed for the representatives are expanded
+ * back to all the points, potentials are only multiplied by the sign of the
+ * element and fields also transformed by it.
+ */
+class Orbits {
+public:
+  /**
+   * @brief Reduce arbitrary points
+   *
+   * Points whose images in the fundamental domain coincide share their
+   * representative, values of the points stay exact. Assigning the same
+   * points under the same symmetry again keeps the previous reduction.
+   */
+  void assign(
+      const Symmetry &symmetry,
+      const std::span<const float> x,
+      const std::span<const float> y
+  );
+  /**
+   * @brief Reduce a grid of `width` by `height` points
+   *
+   * Points are at `origin + step * (column, row)`, row by row. Only the grid
+   * points in the fundamental domain and its border are evaluated. Points
+   * whose images fall between them are bilinearly interpolated from the four
+   * around, the ones with images outside of the grid get their own
+   * representative.
+   */
+  void assign_grid(
+      const Symmetry &symmetry,
+      const raylib::Vector2 origin,
+      const raylib::Vector2 step,
+      const size_t width,
+      const size_t height
+  );
+
+  /// Representatives, that have to be evaluated
+  std::span<const float> x() const { return _x; }
+  std::span<const float> y() const { return _y; }
+  size_t size() const { return _x.size(); }
+  /// Number of all the points
+  size_t points() const { return images.size(); }
+
+  /**
+   * @brief Expand scalar values of the representatives to all the points
+   *
+   * Every point has `stride` consecutive values, like the steps of a series.
+   */
+  void expand(
+      const std::span<const float> values,
+      const std::span<float> out,
+      const size_t stride = 1
+  ) const;
+  /// Expand vectors of the representatives to all the points, see above
+  void expand(
+      const std::span<const float> values_x,
+      const std::span<const float> values_y,
+      const std::span<float> out_x,
+      const std::span<float> out_y,
+      const size_t stride = 1
+  ) const;
+
+private:
+  struct Image {
+    /// Representatives with their weights, unused ones have weight 0
+    std::array<uint32_t, 4> sources;
+    std::array<float, 4> weights;
+    uint32_t element;
+  };
+
+  /// Append a representative and return its index
+  uint32_t add(const raylib::Vector2 point);
+
+  std::vector<Symmetry::Transform> transforms{};
+  std::vector<Image> images{};
+  std::vector<float> _x{};
+  std::vector<float> _y{};
+  /// Representatives of the grid points, `NONE` for interpolated ones
+  std::vector<uint32_t> grid_sources{};
+
+  // Input of the last `assign`, to skip reducing the same points again
+  bool assigned = false;
+  Symmetry assigned_symmetry{};
+  std::vector<float> assigned_x{};
+  std::vector<float> assigned_y{};
+};
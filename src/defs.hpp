@@ -18,8 +18,61 @@ constexpr float GLOBAL_SCALE = 100.0f;
 
 constexpr int LINES_PER_CHARGE = 12;
 
+// Evenly spaced field lines
+constexpr float LINE_SEPARATION = 40.f; // on screen
+constexpr float LINE_TEST_RATIO = 0.5f; // of the separation
+constexpr size_t MAX_FIELD_LINES = 300;
+constexpr size_t MAX_FIELD_LINE_VERTICES = 200'000;
+
 constexpr int BACKGROUND_SUBSAMPLING = 2;
 
+// Plot of user probes
+constexpr float PLOT_SAMPLE_RATE = 240.f; // per second of simulation time
+constexpr float PLOT_HISTORY = 30.f;      // seconds of simulation time
+constexpr size_t SPECTRUM_WINDOW = 1024;  // samples, power of two
+constexpr size_t SPECTRUM_BINS = 128;     // lowest frequencies shown
+
+// Probe grid level of detail
+constexpr size_t PROBE_BUDGET = 4096;
+constexpr float PROBE_DETAIL_SHARE = 0.25f; // of the budget, for refinement
+constexpr int PROBE_DETAIL_LEVELS = 3;
+constexpr float PROBE_REFINE_THRESHOLD = 0.2f; // relative variation of E
+
+// Charges with the same strength expression, updated on all threads
+constexpr size_t STRENGTH_PARALLEL_GROUP = 1024;
+
+// Symmetries of the charges
+constexpr float SYMMETRY_TOLERANCE = 0.5f;  // in world units
+constexpr size_t SYMMETRY_MAX_ROTATION = 8; // highest order looked for
+// Fewest sources evaluated per point, for which reducing the points pays off
+constexpr size_t SYMMETRY_MIN_SOURCES = 4;
+// Values expanded from the representatives on all threads
+constexpr size_t SYMMETRY_PARALLEL_POINTS = 1 << 16;
+
+// Frames of periodic scenes
+constexpr double FRAME_CACHE_STEP = 1.0 / 60.0;  // of simulation time
+constexpr double FRAME_CACHE_MAX_PERIOD = 120.0; // longer ones aren't cached
+constexpr size_t FRAME_CACHE_MEMORY = 512 << 20; // bytes
+
+// Heatmap keyframes, spaced by how fast the strengths change
+constexpr double KEYFRAME_MIN_INTERVAL = 1.0 / 30.0; // of simulation time
+constexpr double KEYFRAME_MAX_INTERVAL = 0.5;        // of simulation time
+constexpr double KEYFRAME_TOLERANCE = 0.05; // relative change of strengths
+
+// Test particles
+constexpr float PARTICLE_CHARGE_MASS_RATIO = 2000.f;
+constexpr float PARTICLE_TIME_STEP = 1.f / 120.f; // of simulation time
+constexpr int PARTICLE_MAX_STEPS = 4;             // per frame
+constexpr float PARTICLE_SIZE = 2.f;              // on screen
+
+// Moving charges
+constexpr float DYNAMICS_TIME_STEP = 1.f / 240.f; // of simulation time
+constexpr int DYNAMICS_MAX_STEPS = 16;            // per frame
+constexpr float DYNAMICS_FORCE_SCALE = 100.f;
+constexpr float DYNAMICS_SOFTENING = 10.f;
+constexpr size_t DYNAMICS_TREE_THRESHOLD = 256; // charges
+constexpr float DYNAMICS_TREE_THETA = 0.5f;
+
 template <> struct std::formatter<raylib::Vector2> {
   constexpr auto parse(std::format_parse_context const &ctx) const {
     return ctx.begin();
@@ -1,10 +1,16 @@
 #include "field.hpp"
 #include "defs.hpp"
+#include "parallel.hpp"
+#include "utils.hpp"
 #include <Vector2.hpp>
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <functional>
 #include <ranges>
 #include <span>
+#include <string>
+#include <vector>
 
 namespace field {
 
@@ -12,22 +18,300 @@ namespace ranges = std::ranges;
 namespace views = std::views;
 namespace placeholders = std::placeholders;
 
-constexpr float FIELD_SCALE = GLOBAL_SCALE * GLOBAL_SCALE;
+// Points are processed in small blocks, that stay in cache while all the
+// sources are added to them.
+constexpr size_t BATCH_BLOCK = 256;
+
+namespace {
+
+const std::array<std::string, 3> BACKGROUND_VARIABLES = {"x", "y", "t"};
+constexpr uint32_t TIME_SLOT = 2;
+
+Background scene_background{};
+
+bool uses_time(const math::Program &program) {
+  return ranges::any_of(program.instructions(), [](const auto &instruction) {
+    return instruction.op == math::OpCode::Variable &&
+           instruction.slot == TIME_SLOT;
+  });
+}
+
+/**
+ * @brief Evaluate a background program for many points, a block at a time
+ *
+ * `fill(start, x, y, t)` writes the variables of the block of points starting
+ * at `start`, `add(start, count, outputs)` adds its results, where
+ * `outputs[output * count + i]` is the `output` of the point `start + i`.
+ */
+template <typename Fill, typename Add>
+void evaluate_blocks(
+    const math::Program &program, const size_t count, Fill &&fill, Add &&add
+) {
+  std::array<float, 3 * BATCH_BLOCK> variables;
+  std::array<float, 2 * BATCH_BLOCK> outputs;
+
+  for (size_t start = 0; start < count; start += BATCH_BLOCK) {
+    const auto block_size = std::min(BATCH_BLOCK, count - start);
+    const auto block_variables = std::span(variables).first(3 * block_size);
+
+    fill(
+        start,
+        block_variables.subspan(0, block_size),
+        block_variables.subspan(block_size, block_size),
+        block_variables.subspan(2 * block_size, block_size)
+    );
+    program.run(block_size, block_variables, outputs);
+    add(start, block_size, std::span<const float>(outputs));
+  }
+}
+
+} // namespace
+
+Background::Background(
+    const std::string &potential,
+    const std::string &e_x,
+    const std::string &e_y
+) {
+  auto present = [](const std::string &expr) { return !trim(expr).empty(); };
+
+  auto add_period = [this](const math::Compiler &compiler, size_t output) {
+    const auto period = compiler.period(output, TIME_SLOT);
+    _period = period && _period ? math::common_period(*_period, *period)
+                                : std::nullopt;
+  };
+
+  if (present(potential)) {
+    math::Compiler compiler{BACKGROUND_VARIABLES};
+    add_period(compiler, compiler.add(potential));
+    potential_program = compiler.build();
+    has_potential = true;
+  }
+
+  if (present(e_x) || present(e_y)) {
+    math::Compiler compiler{BACKGROUND_VARIABLES};
+    field_outputs = {
+        compiler.add(present(e_x) ? e_x : "0"),
+        compiler.add(present(e_y) ? e_y : "0"),
+    };
+    add_period(compiler, field_outputs[0]);
+    add_period(compiler, field_outputs[1]);
+    field_program = compiler.build();
+    has_field = true;
+  }
+
+  _time_dependent = uses_time(potential_program) || uses_time(field_program);
+}
+
+// Scenarios have `y` pointing up and coordinates divided by `GLOBAL_SCALE`.
+// The potential and the field come out in the same units as the ones of the
+// charges, so only the direction of `y` needs flipping.
+
+float Background::potential(
+    const raylib::Vector2 point, const float time
+) const {
+  if (!has_potential)
+    return 0.f;
+
+  const std::array variables{
+      point.x / GLOBAL_SCALE, -point.y / GLOBAL_SCALE, time
+  };
+  return potential_program(variables);
+}
 
 raylib::Vector2
-E(const raylib::Vector2 point, const std::span<const Charge> &charges) {
+Background::E(const raylib::Vector2 point, const float time) const {
+  if (!has_field)
+    return {};
+
+  const std::array variables{
+      point.x / GLOBAL_SCALE, -point.y / GLOBAL_SCALE, time
+  };
+  std::array<float, 2> outputs{};
+  field_program.run(variables, outputs);
+  return {outputs[field_outputs[0]], -outputs[field_outputs[1]]};
+}
+
+void Background::add_potential(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const float time,
+    const std::span<float> out
+) const {
+  if (!has_potential)
+    return;
+
+  evaluate_blocks(
+      potential_program,
+      x.size(),
+      [&](size_t start, auto block_x, auto block_y, auto block_t) {
+        for (size_t i = 0; i < block_x.size(); ++i) {
+          block_x[i] = x[start + i] / GLOBAL_SCALE;
+          block_y[i] = -y[start + i] / GLOBAL_SCALE;
+        }
+        std::fill(block_t.begin(), block_t.end(), time);
+      },
+      [&](size_t start, size_t count, auto outputs) {
+        for (size_t i = 0; i < count; ++i) {
+          out[start + i] += outputs[i];
+        }
+      }
+  );
+}
+
+void Background::add_E(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const float time,
+    const std::span<float> out_x,
+    const std::span<float> out_y
+) const {
+  if (!has_field)
+    return;
+
+  evaluate_blocks(
+      field_program,
+      x.size(),
+      [&](size_t start, auto block_x, auto block_y, auto block_t) {
+        for (size_t i = 0; i < block_x.size(); ++i) {
+          block_x[i] = x[start + i] / GLOBAL_SCALE;
+          block_y[i] = -y[start + i] / GLOBAL_SCALE;
+        }
+        std::fill(block_t.begin(), block_t.end(), time);
+      },
+      [&](size_t start, size_t count, auto outputs) {
+        const auto e_x = outputs.subspan(field_outputs[0] * count, count);
+        const auto e_y = outputs.subspan(field_outputs[1] * count, count);
+        for (size_t i = 0; i < count; ++i) {
+          out_x[start + i] += e_x[i];
+          out_y[start + i] -= e_y[i];
+        }
+      }
+  );
+}
+
+void Background::add_potential_series(
+    const raylib::Vector2 point,
+    const std::span<const double> times,
+    const std::span<float> out
+) const {
+  if (!has_potential)
+    return;
+
+  evaluate_blocks(
+      potential_program,
+      times.size(),
+      [&](size_t start, auto block_x, auto block_y, auto block_t) {
+        std::fill(block_x.begin(), block_x.end(), point.x / GLOBAL_SCALE);
+        std::fill(block_y.begin(), block_y.end(), -point.y / GLOBAL_SCALE);
+        for (size_t i = 0; i < block_t.size(); ++i) {
+          block_t[i] = static_cast<float>(times[start + i]);
+        }
+      },
+      [&](size_t start, size_t count, auto outputs) {
+        for (size_t i = 0; i < count; ++i) {
+          out[start + i] += outputs[i];
+        }
+      }
+  );
+}
+
+void Background::add_E_series(
+    const raylib::Vector2 point,
+    const std::span<const double> times,
+    const std::span<float> out_x,
+    const std::span<float> out_y
+) const {
+  if (!has_field)
+    return;
+
+  evaluate_blocks(
+      field_program,
+      times.size(),
+      [&](size_t start, auto block_x, auto block_y, auto block_t) {
+        std::fill(block_x.begin(), block_x.end(), point.x / GLOBAL_SCALE);
+        std::fill(block_y.begin(), block_y.end(), -point.y / GLOBAL_SCALE);
+        for (size_t i = 0; i < block_t.size(); ++i) {
+          block_t[i] = static_cast<float>(times[start + i]);
+        }
+      },
+      [&](size_t start, size_t count, auto outputs) {
+        const auto e_x = outputs.subspan(field_outputs[0] * count, count);
+        const auto e_y = outputs.subspan(field_outputs[1] * count, count);
+        for (size_t i = 0; i < count; ++i) {
+          out_x[start + i] += e_x[i];
+          out_y[start + i] -= e_y[i];
+        }
+      }
+  );
+}
+
+void set_background(Background &&background) {
+  scene_background = std::move(background);
+}
+
+const Background &background() { return scene_background; }
+
+void Sources::assign(
+    const std::span<const Charge> &charges, const double elapsedTime
+) {
+  // Otherwise snapshots of an unchanged scene would differ in every frame
+  time = scene_background.time_dependent() ? static_cast<float>(elapsedTime)
+                                           : 0.f;
+
+  x.resize(charges.size());
+  y.resize(charges.size());
+  strength.resize(charges.size());
+
+  for (const auto &[i, charge] : charges | views::enumerate) {
+    auto position = charge.position();
+    x[i] = position.x;
+    y[i] = position.y;
+    strength[i] = charge.strength();
+  }
+}
+
+void Sources::assign_at(
+    const std::span<const Charge> &charges, const double elapsedTime
+) {
+  assign(charges, elapsedTime);
+
+  for (const auto &[i, charge] : charges | views::enumerate) {
+    strength[i] = charge.strength_at(elapsedTime);
+  }
+}
+
+raylib::Vector2 E(
+    const raylib::Vector2 point,
+    const std::span<const Charge> &charges,
+    const double elapsedTime
+) {
   return ranges::fold_left(
              views::transform(
                  charges, [&point](auto &charge) { return charge.E(point); }
              ),
              raylib::Vector2{},
              std::plus<>()
-         ) *
-         FIELD_SCALE;
+         ) * FIELD_SCALE +
+         scene_background.E(point, static_cast<float>(elapsedTime));
+}
+
+raylib::Vector2 E(const raylib::Vector2 point, const Sources &sources) {
+  raylib::Vector2 result{};
+
+  for (size_t i = 0; i < sources.size(); ++i) {
+    auto direction = point - sources.position(i);
+    auto distance = direction.Length();
+    result +=
+        direction * sources.strength[i] / (distance * distance * distance);
+  }
+
+  return result * FIELD_SCALE + scene_background.E(point, sources.time);
 }
 
 float potential(
-    const raylib::Vector2 point, const std::span<const Charge> &charges
+    const raylib::Vector2 point,
+    const std::span<const Charge> &charges,
+    const double elapsedTime
 ) {
   return ranges::fold_left(
              views::transform(
@@ -36,8 +320,202 @@ float potential(
              ),
              0.f,
              std::plus<>()
-         ) *
-         FIELD_SCALE;
+         ) * FIELD_SCALE +
+         scene_background.potential(point, static_cast<float>(elapsedTime));
+}
+
+float potential(const raylib::Vector2 point, const Sources &sources) {
+  float result = 0.f;
+
+  for (size_t i = 0; i < sources.size(); ++i) {
+    auto distance_sqr = (point - sources.position(i)).LengthSqr();
+    result += sources.strength[i] / distance_sqr;
+  }
+
+  return result * FIELD_SCALE + scene_background.potential(point, sources.time);
+}
+
+void E(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<float> out_x,
+    const std::span<float> out_y
+) {
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t block = start; block < end; block += BATCH_BLOCK) {
+      const auto block_end = std::min(end, block + BATCH_BLOCK);
+
+      std::fill(out_x.begin() + block, out_x.begin() + block_end, 0.f);
+      std::fill(out_y.begin() + block, out_y.begin() + block_end, 0.f);
+
+      for (size_t j = 0; j < sources.size(); ++j) {
+        const auto source_x = sources.x[j];
+        const auto source_y = sources.y[j];
+        const auto strength = sources.strength[j];
+
+        for (size_t i = block; i < block_end; ++i) {
+          const auto dx = x[i] - source_x;
+          const auto dy = y[i] - source_y;
+          const auto distance_sqr = dx * dx + dy * dy;
+          const auto factor =
+              strength / (distance_sqr * std::sqrt(distance_sqr));
+          out_x[i] += dx * factor;
+          out_y[i] += dy * factor;
+        }
+      }
+
+      for (size_t i = block; i < block_end; ++i) {
+        out_x[i] *= FIELD_SCALE;
+        out_y[i] *= FIELD_SCALE;
+      }
+
+      const auto count = block_end - block;
+      scene_background.add_E(
+          x.subspan(block, count),
+          y.subspan(block, count),
+          sources.time,
+          out_x.subspan(block, count),
+          out_y.subspan(block, count)
+      );
+    }
+  });
+}
+
+void potential(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<float> out
+) {
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t block = start; block < end; block += BATCH_BLOCK) {
+      const auto block_end = std::min(end, block + BATCH_BLOCK);
+
+      std::fill(out.begin() + block, out.begin() + block_end, 0.f);
+
+      for (size_t j = 0; j < sources.size(); ++j) {
+        const auto source_x = sources.x[j];
+        const auto source_y = sources.y[j];
+        const auto strength = sources.strength[j];
+
+        for (size_t i = block; i < block_end; ++i) {
+          const auto dx = x[i] - source_x;
+          const auto dy = y[i] - source_y;
+          out[i] += strength / (dx * dx + dy * dy);
+        }
+      }
+
+      for (size_t i = block; i < block_end; ++i) {
+        out[i] *= FIELD_SCALE;
+      }
+
+      const auto count = block_end - block;
+      scene_background.add_potential(
+          x.subspan(block, count),
+          y.subspan(block, count),
+          sources.time,
+          out.subspan(block, count)
+      );
+    }
+  });
+}
+
+void potential_series(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<const double> times,
+    const std::span<const float> strengths,
+    const std::span<float> out,
+    std::vector<float> &scratch
+) {
+  const auto steps = times.size();
+  const auto source_count = sources.size();
+
+  // Distances don't change between steps, so every step is just a weighted
+  // sum of the same inverse squared distances. Each point has its own row of
+  // them.
+  scratch.resize(x.size() * source_count);
+
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      const auto inverse_distance_sqr =
+          std::span(scratch).subspan(i * source_count, source_count);
+
+      for (size_t j = 0; j < source_count; ++j) {
+        const auto dx = x[i] - sources.x[j];
+        const auto dy = y[i] - sources.y[j];
+        inverse_distance_sqr[j] = FIELD_SCALE / (dx * dx + dy * dy);
+      }
+
+      const auto point_out = out.subspan(i * steps, steps);
+      std::fill(point_out.begin(), point_out.end(), 0.f);
+
+      for (size_t j = 0; j < source_count; ++j) {
+        const auto weight = inverse_distance_sqr[j];
+        const auto source_strengths = strengths.subspan(j * steps, steps);
+
+        for (size_t step = 0; step < steps; ++step) {
+          point_out[step] += source_strengths[step] * weight;
+        }
+      }
+
+      scene_background.add_potential_series({x[i], y[i]}, times, point_out);
+    }
+  });
+}
+
+void E_series(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<const double> times,
+    const std::span<const float> strengths,
+    const std::span<float> out_x,
+    const std::span<float> out_y,
+    std::vector<float> &scratch
+) {
+  const auto steps = times.size();
+  const auto source_count = sources.size();
+
+  // Rows of the weights in `x` and `y` of each point
+  scratch.resize(x.size() * 2 * source_count);
+
+  parallel::for_each(x.size(), [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      const auto weights =
+          std::span(scratch).subspan(i * 2 * source_count, 2 * source_count);
+      const auto weight_x = weights.first(source_count);
+      const auto weight_y = weights.last(source_count);
+
+      for (size_t j = 0; j < source_count; ++j) {
+        const auto dx = x[i] - sources.x[j];
+        const auto dy = y[i] - sources.y[j];
+        const auto distance_sqr = dx * dx + dy * dy;
+        const auto factor =
+            FIELD_SCALE / (distance_sqr * std::sqrt(distance_sqr));
+        weight_x[j] = dx * factor;
+        weight_y[j] = dy * factor;
+      }
+
+      const auto point_x = out_x.subspan(i * steps, steps);
+      const auto point_y = out_y.subspan(i * steps, steps);
+      std::fill(point_x.begin(), point_x.end(), 0.f);
+      std::fill(point_y.begin(), point_y.end(), 0.f);
+
+      for (size_t j = 0; j < source_count; ++j) {
+        const auto source_strengths = strengths.subspan(j * steps, steps);
+
+        for (size_t step = 0; step < steps; ++step) {
+          point_x[step] += source_strengths[step] * weight_x[j];
+          point_y[step] += source_strengths[step] * weight_y[j];
+        }
+      }
+
+      scene_background.add_E_series({x[i], y[i]}, times, point_x, point_y);
+    }
+  });
 }
 
 } // namespace field
@@ -1,15 +1,193 @@
 #pragma once
 #include "Charge.hpp"
+#include "MathEval.hpp"
+#include "defs.hpp"
 #include <Vector2.hpp>
+#include <array>
+#include <optional>
 #include <span>
+#include <string>
+#include <vector>
 
 namespace field {
 
-raylib::Vector2
-E(const raylib::Vector2 point, const std::span<const Charge> &charges);
+constexpr float FIELD_SCALE = GLOBAL_SCALE * GLOBAL_SCALE;
+
+/**
+ * @brief Potential and field of the scene, that don't come from its charges
+ *
+ * Given by expressions in `x` and `y`, in the units of the scenario with `y`
+ * pointing up, and in the time `t`. The potential and the field are
+ * independent terms, neither is derived from the other one.
+ *
+ * The expressions are compiled once and evaluated in batches of points, so
+ * adding them to every pixel of the heatmap stays cheap.
+ */
+class Background {
+public:
+  Background() = default;
+  /// Empty expressions are left out
+  /// @throws parser_exception when an expression isn't valid
+  Background(
+      const std::string &potential,
+      const std::string &e_x,
+      const std::string &e_y
+  );
+
+  bool empty() const { return !has_potential && !has_field; }
+  /// Whether the terms change over time
+  bool time_dependent() const { return _time_dependent; }
+  /// Common period of the terms in time, 0 when they don't change and
+  /// `nullopt` when there's none
+  std::optional<double> period() const { return _period; }
+
+  float potential(const raylib::Vector2 point, const float time) const;
+  raylib::Vector2 E(const raylib::Vector2 point, const float time) const;
+
+  /// Add the potential in many points to `out`
+  void add_potential(
+      const std::span<const float> x,
+      const std::span<const float> y,
+      const float time,
+      const std::span<float> out
+  ) const;
+  /// Add the field in many points to `out_x` and `out_y`
+  void add_E(
+      const std::span<const float> x,
+      const std::span<const float> y,
+      const float time,
+      const std::span<float> out_x,
+      const std::span<float> out_y
+  ) const;
+
+  /// Add the potential in a single point at many times to `out`
+  void add_potential_series(
+      const raylib::Vector2 point,
+      const std::span<const double> times,
+      const std::span<float> out
+  ) const;
+  /// Add the field in a single point at many times to `out_x` and `out_y`
+  void add_E_series(
+      const raylib::Vector2 point,
+      const std::span<const double> times,
+      const std::span<float> out_x,
+      const std::span<float> out_y
+  ) const;
+
+private:
+  math::Program potential_program{};
+  math::Program field_program{};
+  /// Outputs of the `x` and `y` components, the same when they're equal
+  std::array<size_t, 2> field_outputs{};
+  bool has_potential = false;
+  bool has_field = false;
+  bool _time_dependent = false;
+  std::optional<double> _period = 0.0;
+};
+
+/// Replace the background of the scene, must not be called while any other
+/// thread evaluates the field
+void set_background(Background &&background);
+const Background &background();
+
+/**
+ * @brief Flat copy of the state of a set of charges
+ *
+ * Unlike `Charge`s it can be freely copied, so it can be handed over to other
+ * threads as a snapshot of the scene.
+ */
+struct Sources {
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> strength{};
+  /// Time of the snapshot, only kept when the background changes over time
+  float time = 0.f;
+
+  void assign(const std::span<const Charge> &charges, const double elapsedTime);
+  /// Like `assign`, with the strengths at `elapsedTime` instead of the ones
+  /// from the last update of the charges
+  void
+  assign_at(const std::span<const Charge> &charges, const double elapsedTime);
+
+  size_t size() const { return strength.size(); }
+  raylib::Vector2 position(const size_t i) const { return {x[i], y[i]}; }
+
+  bool operator==(const Sources &) const = default;
+};
+
+raylib::Vector2 E(
+    const raylib::Vector2 point,
+    const std::span<const Charge> &charges,
+    const double elapsedTime
+);
+raylib::Vector2 E(const raylib::Vector2 point, const Sources &sources);
 
 float potential(
-    const raylib::Vector2 point, const std::span<const Charge> &charges
+    const raylib::Vector2 point,
+    const std::span<const Charge> &charges,
+    const double elapsedTime
+);
+float potential(const raylib::Vector2 point, const Sources &sources);
+
+/**
+ * @brief Evaluate the field in many points at once
+ *
+ * Points are given as separate coordinate arrays, the work is spread over all
+ * threads. Equivalent to calling `E(point, sources)` for each point.
+ */
+void E(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<float> out_x,
+    const std::span<float> out_y
+);
+
+/**
+ * @brief Evaluate the potential in many points at once
+ *
+ * Batched counterpart of `potential(point, sources)`, see `E` above.
+ */
+void potential(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<float> out
+);
+
+/**
+ * @brief Evaluate the potential in many points over many time steps
+ *
+ * The sources stay in place, only their strengths change. There's a step for
+ * each of the `times`, `strengths` holds for each source its strengths in all
+ * steps and `out` is filled with the potential in each point in all steps.
+ * The points are spread over all threads, `scratch` is working memory kept by
+ * the caller, so it's reused between calls.
+ */
+void potential_series(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<const double> times,
+    const std::span<const float> strengths,
+    const std::span<float> out,
+    std::vector<float> &scratch
+);
+
+/**
+ * @brief Evaluate the field in many points over many time steps
+ *
+ * Counterpart of `potential_series` for the field, see above.
+ */
+void E_series(
+    const std::span<const float> x,
+    const std::span<const float> y,
+    const Sources &sources,
+    const std::span<const double> times,
+    const std::span<const float> strengths,
+    const std::span<float> out_x,
+    const std::span<float> out_y,
+    std::vector<float> &scratch
 );
 
 } // namespace field
@@ -1,12 +1,22 @@
 #include "Charge.hpp"
+#include "Dynamics.hpp"
 #include "FieldLine.hpp"
+#include "FrameCache.hpp"
 #include "Grid.hpp"
 #include "HeatMap.hpp"
+#include "Keyframes.hpp"
+#include "Label.hpp"
+#include "Particles.hpp"
 #include "Plot.hpp"
 #include "Position.hpp"
 #include "Probe.hpp"
+#include "Recorder.hpp"
+#include "Spectrum.hpp"
+#include "Strengths.hpp"
+#include "Symmetry.hpp"
 #include "defs.hpp"
 #include "field.hpp"
+#include "parallel.hpp"
 #include "raylib.h"
 #include "raymath.h"
 #include "utils.hpp"
@@ -22,6 +32,7 @@
 #include <Vector2.hpp>
 #include <Window.hpp>
 #include <algorithm>
+#include <cstdlib>
 #include <format>
 #include <fstream>
 #include <functional>
@@ -39,6 +50,7 @@ extern "C" {
 }
 #include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ranges = std::ranges;
@@ -68,7 +80,9 @@ std::optional<nlohmann::json> load_scenario_json(const std::string &scenario) {
                       : std::nullopt;
 }
 
-std::vector<Charge> load_charges_from_json(nlohmann::json data) {
+/// `nullopt` when a charge isn't valid, the reason is reported
+std::optional<std::vector<Charge>>
+load_charges_from_json(nlohmann::json data) {
   std::vector<Charge> charges{};
   for (const auto &charge : data["charges"]) {
     auto position = charge["position"];
@@ -86,11 +100,70 @@ std::vector<Charge> load_charges_from_json(nlohmann::json data) {
       charges.emplace_back(
           pos, std::make_unique<charge::VariableStrength>(func)
       );
+    } else {
+      continue;
+    }
+
+    if (charge.contains("mass")) {
+      const float mass = charge["mass"];
+      // Forces are divided by the mass, charges without one can't move
+      if (!(mass > 0.f)) {
+        std::cerr << "Invalid mass of charge " << charges.size() - 1 << ": "
+                  << mass << ", it must be positive" << std::endl;
+        return std::nullopt;
+      }
+      charges.back().mass(mass);
+    }
+
+    if (charge.contains("velocity")) {
+      auto velocity = charge["velocity"];
+      raylib::Vector2 vel{velocity["x"], velocity["y"]};
+      vel.y *= -1.f;
+      vel *= 100.f;
+      charges.back().velocity(vel);
     }
   }
   return charges;
 }
 
+/// A single expression, or an array of expressions, which are summed
+std::string load_terms_from_json(const nlohmann::json &terms) {
+  if (terms.is_string())
+    return terms.get<std::string>();
+
+  std::string sum{};
+  for (const auto &term : terms) {
+    if (!sum.empty())
+      sum += "+";
+    sum += "(" + term.get<std::string>() + ")";
+  }
+  return sum;
+}
+
+field::Background load_background_from_json(const nlohmann::json &data) {
+  if (!data.contains("background"))
+    return {};
+
+  const auto &background = data["background"];
+  std::string potential{};
+  std::string e_x{};
+  std::string e_y{};
+
+  if (background.contains("potential")) {
+    potential = load_terms_from_json(background["potential"]);
+  }
+
+  if (background.contains("field")) {
+    const auto &field = background["field"];
+    if (field.contains("x"))
+      e_x = load_terms_from_json(field["x"]);
+    if (field.contains("y"))
+      e_y = load_terms_from_json(field["y"]);
+  }
+
+  return field::Background(potential, e_x, e_y);
+}
+
 raylib::Vector2 get_mouse_in_world(raylib::Camera2D camera) {
   return camera.GetScreenToWorld(raylib::Mouse::GetPosition());
 }
@@ -102,6 +175,17 @@ int main(int argc, char const *argv[]) {
   }
 
   raylib::Vector2 grid_spacing = {50.f, 50.f};
+  auto seeding = FieldLines::Seeding::PerCharge;
+  size_t particle_count = 0;
+  auto dynamic_charges = false;
+  std::optional<std::string> recording_path = std::nullopt;
+  auto show_spectrum = false;
+  auto interpolate_heatmap = false;
+
+  // Garbage in the variable reads as 0, which picks the hardware threads
+  if (const auto *threads = std::getenv("ELEKTROVIZ_THREADS"))
+    parallel::set_thread_count(std::strtoul(threads, nullptr, 10));
+
   if (argc > 2) {
     for (int i = 2; i < argc; i++) {
       auto size_spec = std::string{argv[i]};
@@ -111,7 +195,20 @@ int main(int argc, char const *argv[]) {
             std::stof(size_spec.substr(0, size_spec.find("x"))),
             std::stof(size_spec.substr(size_spec.find("x") + 1))
         };
-        break;
+      } else if (size_spec == "-e") {
+        seeding = FieldLines::Seeding::EvenlySpaced;
+      } else if (size_spec == "-d") {
+        dynamic_charges = true;
+      } else if (size_spec == "-f") {
+        show_spectrum = true;
+      } else if (size_spec == "-k") {
+        interpolate_heatmap = true;
+      } else if (size_spec.starts_with("-p")) {
+        particle_count = std::stoul(size_spec.substr(2));
+      } else if (size_spec.starts_with("-j")) {
+        parallel::set_thread_count(std::stoul(size_spec.substr(2)));
+      } else if (size_spec.starts_with("-r")) {
+        recording_path = size_spec.substr(2);
       } else {
         std::println(std::cerr, "WARNING: Unknown argument: '{}'", size_spec);
       }
@@ -127,9 +224,27 @@ int main(int argc, char const *argv[]) {
 
   auto data = scenarion_result.value();
 
+  std::optional<Recorder> recorder = std::nullopt;
+  if (recording_path.has_value()) {
+    recorder.emplace(*recording_path);
+    if (!recorder->is_open()) {
+      std::cerr << "Failed to open recording: " << *recording_path
+                << std::endl;
+      return 1;
+    }
+  }
+
+  auto loaded_charges = load_charges_from_json(data);
+  if (!loaded_charges.has_value()) {
+    std::cerr << "Failed to load scenario: " << scenario << std::endl;
+    return 1;
+  }
+
   std::cout << "Loaded scenario: " << scenario << std::endl;
 
-  auto charges = load_charges_from_json(data);
+  auto charges = std::move(*loaded_charges);
+  Strengths strengths{charges};
+  field::set_background(load_background_from_json(data));
 
   std::cout << std::format("Loaded {} charge(s)", charges.size()) << std::endl;
   std::cout << "Charges: [" << std::endl;
@@ -139,9 +254,7 @@ int main(int argc, char const *argv[]) {
   std::cout << "]" << std::endl;
 
   Probe probe(
-      std::make_unique<position::Rotating>(
-          raylib::Vector2{0, 0}, 100.f, PI / 6.f
-      ),
+      position::Rotating(raylib::Vector2{0, 0}, 100.f, PI / 6.f),
       raylib::Color::Green()
   );
 
@@ -180,7 +293,22 @@ int main(int argc, char const *argv[]) {
       {150, 150, 150, 255}
   };
 
-  FieldLines field_lines{LINES_PER_CHARGE};
+  // Periodic scenes repeat their frames, unless the charges move on their own
+  const auto strength_period = strengths.period();
+  const auto background_period = field::background().period();
+  std::optional<double> period = std::nullopt;
+  if (strength_period && background_period && !dynamic_charges)
+    period = math::common_period(*strength_period, *background_period);
+
+  FrameCache frame_cache{period, FRAME_CACHE_MEMORY};
+
+  FieldLines field_lines{LINES_PER_CHARGE, seeding};
+  field_lines.cache_with(&frame_cache);
+
+  Particles particles{particle_count};
+
+  Dynamics dynamics{};
+  field::Sources particle_sources{};
 
   HeatMap background{
       raylib::Vector2{0, 0},
@@ -190,16 +318,43 @@ int main(int argc, char const *argv[]) {
       Charge::NEGATIVE,
       static_cast<float>(BACKGROUND_SUBSAMPLING)
   };
+  // Pixels of the background are evaluated as one batch of points, only in
+  // the fundamental domain of the symmetry of the charges
+  Symmetry symmetry{};
+  uint64_t layout_generation = 0;
+  field::Sources background_sources{};
+  Orbits pixel_orbits{};
+  std::vector<float> orbit_values{};
+  std::vector<float> pixel_values{};
+  // Moving charges change the layout in every frame, so the keyframes would
+  // never be ready in time
+  std::optional<Keyframes> keyframes = std::nullopt;
+  if (interpolate_heatmap && !dynamic_charges)
+    keyframes.emplace();
 
   auto simulation_speed = 1.f;
   auto simulation_time = 0.0;
 
+  std::optional<Spectrum> spectrum = std::nullopt;
+  if (show_spectrum) {
+    spectrum.emplace(
+        raylib::Vector2{screen_size.x * 0.4f, screen_size.y / 4.f},
+        raylib::Vector2{screen_size.x * 0.6f, screen_size.y / 6.f},
+        raylib::Color::Black(),
+        raylib::Color::RayWhite()
+    );
+  }
+
   Plot plot(
       {screen_size.x * 0.3f, 0.0},
       {screen_size.x * 0.7f, screen_size.y / 4.f},
       raylib::Color::Black(),
       raylib::Color::RayWhite()
   );
+  if (recorder.has_value())
+    plot.record_to(&*recorder);
+  if (spectrum.has_value())
+    plot.analyze_with(&*spectrum);
 
   std::optional<int> selected_charge_idx = std::nullopt;
 
@@ -209,8 +364,69 @@ int main(int argc, char const *argv[]) {
     plot.resize(
         {screen_size.x * 0.4f, 0.0}, {screen_size.x * 0.6f, screen_size.y / 4.f}
     );
+    if (spectrum.has_value()) {
+      spectrum->resize(
+          {screen_size.x * 0.4f, screen_size.y / 4.f},
+          {screen_size.x * 0.6f, screen_size.y / 6.f}
+      );
+    }
   };
 
+  Label<int> fps_label{"FPS: {}", FONT_SIZE};
+  Label<int, int> window_label{"Window size: {}x{}", FONT_SIZE};
+  Label<float> speed_label{"Speed: {:.4g}x", FONT_SIZE};
+
+  // Texts, that change only with the size of the window
+  TextLayer static_text{};
+  auto layout_static_text = [&] {
+    static_text.clear();
+
+    const auto gradient_height = 60.f;
+    const auto small_color = raylib::Color::RayWhite();
+
+    static_text.add(
+        "-1E10",
+        {screen_size.x * 0.5f + 5.f, screen_size.y - gradient_height},
+        FONT_SIZE_SMALL,
+        small_color
+    );
+
+    static_text.add(
+        "0",
+        {screen_size.x * 0.7f, screen_size.y - gradient_height},
+        FONT_SIZE_SMALL,
+        small_color
+    );
+
+    std::string mid_text = "Electric potential [V]";
+    auto mid_width = raylib::MeasureText(mid_text, FONT_SIZE_SMALL);
+    static_text.add(
+        mid_text,
+        {screen_size.x * 0.7f - mid_width / 2.f,
+         screen_size.y - 7.f - FONT_SIZE_SMALL},
+        FONT_SIZE_SMALL,
+        small_color
+    );
+
+    std::string max_text = "1E10";
+    auto max_width = raylib::MeasureText(max_text, FONT_SIZE_SMALL);
+    static_text.add(
+        max_text,
+        {screen_size.x * 0.9f - max_width - 5.f,
+         screen_size.y - gradient_height},
+        FONT_SIZE_SMALL,
+        small_color
+    );
+
+    static_text.add(
+        std::format("Scenario: {}", scenario),
+        {10.f, 10.f + 2 * FONT_SIZE},
+        FONT_SIZE,
+        textColor
+    );
+  };
+  layout_static_text();
+
   auto recalculate_zoom = [&] {
     camera.zoom =
         std::min(screen_size.x / 600.f, screen_size.y / 600.f) * zoom_modifier;
@@ -237,15 +453,42 @@ int main(int argc, char const *argv[]) {
 
       resize_grid();
       resize_plot();
+      layout_static_text();
 
       background.resize(screen_size / BACKGROUND_SUBSAMPLING);
     }
 
     // Update
-    for (auto &charge : charges) {
-      charge.update(frameTime, simulation_time);
+    strengths.update(simulation_time, charges);
+    if (dynamic_charges) {
+      dynamics.update(frameTime, simulation_time, charges);
     }
-    grid.update(frameTime, simulation_time, charges);
+
+    frame_cache.validate(charges, camera, screen_size);
+    const auto layout_stable = frame_cache.generation() == layout_generation;
+    if (!layout_stable) {
+      layout_generation = frame_cache.generation();
+      symmetry = Symmetry::detect(charges);
+
+      // The camera only scales and moves, so a pixel step is the same
+      // everywhere
+      const auto reverse_camera_matrix =
+          raylib::Matrix(camera.GetMatrix()).Invert();
+      const auto origin =
+          raylib::Vector2{0.f, 0.f}.Transform(reverse_camera_matrix);
+      const auto step =
+          raylib::Vector2{BACKGROUND_SUBSAMPLING, BACKGROUND_SUBSAMPLING}
+              .Transform(reverse_camera_matrix) -
+          origin;
+
+      pixel_orbits.assign_grid(
+          symmetry, origin, step, background.width(), background.height()
+      );
+      orbit_values.resize(pixel_orbits.size());
+      pixel_values.resize(pixel_orbits.points());
+    }
+
+    grid.update(frameTime, simulation_time, charges, symmetry);
     probe.update(frameTime, simulation_time, charges);
     if (!user_probes.empty()) {
       for (auto &user_probe : user_probes) {
@@ -254,22 +497,83 @@ int main(int argc, char const *argv[]) {
         }
       }
 
-      plot.update(frameTime, w.GetTime(), simulation_speed, user_probes);
+      plot.update(simulation_time, charges, user_probes, symmetry);
+    }
+
+    auto view_top_left = camera.GetScreenToWorld({0.f, 0.f});
+    auto view_bottom_right = camera.GetScreenToWorld(screen_size);
+    raylib::Rectangle view{
+        view_top_left.x,
+        view_top_left.y,
+        view_bottom_right.x - view_top_left.x,
+        view_bottom_right.y - view_top_left.y
+    };
+
+    field_lines.update(
+        charges,
+        simulation_time,
+        camera.GetScreenToWorld(wanted_target),
+        view,
+        camera.zoom
+    );
+
+    if (particle_count > 0) {
+      particle_sources.assign(charges, simulation_time);
+      particles.update(frameTime, particle_sources, view);
     }
 
-    field_lines.update(charges, camera.GetScreenToWorld(wanted_target));
+    const auto frame_key = frame_cache.key(simulation_time);
+    const auto *cached_heatmap =
+        frame_key ? frame_cache.heatmap(*frame_key) : nullptr;
 
-    auto reverse_camera_matrix = raylib::Matrix(camera.GetMatrix()).Invert();
+    if (cached_heatmap != nullptr) {
+      background.update(*cached_heatmap);
+    } else {
+      // Cached scenes get exact frames, that are reused in the next periods.
+      // While the view or the charges keep changing, like when panning, the
+      // keyframes would be outdated before they're ready, so they wait until
+      // it's stable for a frame.
+      const auto interpolated =
+          !frame_key && keyframes.has_value() && layout_stable;
+      if (interpolated && keyframes->generation() != frame_cache.generation()) {
+        keyframes->reset(
+            frame_cache.generation(),
+            pixel_orbits.x(),
+            pixel_orbits.y(),
+            charges,
+            simulation_time,
+            simulation_speed
+        );
+      }
 
-    background.update([&reverse_camera_matrix, &charges](size_t x, size_t y) {
-      auto x_pos = static_cast<float>(x * BACKGROUND_SUBSAMPLING);
-      auto y_pos = static_cast<float>(y * BACKGROUND_SUBSAMPLING);
+      if (interpolated && keyframes->interpolate(
+                              charges,
+                              simulation_time,
+                              simulation_speed,
+                              orbit_values
+                          )) {
+        pixel_orbits.expand(orbit_values, pixel_values);
+        background.update(pixel_values);
+      } else {
+        if (frame_key) {
+          background_sources.assign_at(charges, frame_cache.time(*frame_key));
+        } else {
+          background_sources.assign(charges, simulation_time);
+        }
 
-      auto position =
-          raylib::Vector2{x_pos, y_pos}.Transform(reverse_camera_matrix);
+        field::potential(
+            pixel_orbits.x(), pixel_orbits.y(), background_sources, orbit_values
+        );
+        for (auto &value : orbit_values) {
+          value = sigmoid(value);
+        }
 
-      return sigmoid(field::potential(position, charges));
-    });
+        pixel_orbits.expand(orbit_values, pixel_values);
+        background.update(pixel_values);
+        if (frame_key)
+          frame_cache.store_heatmap(*frame_key, pixel_values);
+      }
+    }
 
     // Draw
     w.BeginDrawing();
@@ -279,7 +583,8 @@ int main(int argc, char const *argv[]) {
     camera.BeginMode();
 
     grid.draw();
-    field_lines.draw();
+    field_lines.draw(view);
+    particles.draw(view, camera.zoom);
     for (const auto &charge : charges) {
       charge.draw();
     }
@@ -310,42 +615,6 @@ int main(int argc, char const *argv[]) {
       }
           .DrawGradientH(raylib::Color::Black(), Charge::POSITIVE);
 
-      raylib::DrawText(
-          std::format("-1E10"),
-          screen_size.x * 0.5f + 5.f,
-          screen_size.y - gradient_height,
-          FONT_SIZE_SMALL,
-          raylib::Color::RayWhite()
-      );
-
-      raylib::DrawText(
-          "0",
-          screen_size.x * 0.7f,
-          screen_size.y - gradient_height,
-          FONT_SIZE_SMALL,
-          raylib::Color::RayWhite()
-      );
-
-      auto mid_text = std::format("Electric potential [V]");
-      raylib::DrawText(
-          mid_text,
-          screen_size.x * 0.7f -
-              raylib::MeasureText(mid_text, FONT_SIZE_SMALL) / 2.f,
-          screen_size.y - 7.f - FONT_SIZE_SMALL,
-          FONT_SIZE_SMALL,
-          raylib::Color::RayWhite()
-      );
-
-      auto max_text = std::format("1E10");
-      raylib::DrawText(
-          max_text,
-          screen_size.x * 0.9f -
-              raylib::MeasureText(max_text, FONT_SIZE_SMALL) - 5.f,
-          screen_size.y - gradient_height,
-          FONT_SIZE_SMALL,
-          raylib::Color::RayWhite()
-      );
-
       raylib::Rectangle{
           screen_size.x * 0.5f,
           screen_size.y - gradient_height - 5.f,
@@ -357,27 +626,19 @@ int main(int argc, char const *argv[]) {
 
     if (!user_probes.empty())
       plot.draw(user_probe_colors);
+    if (!user_probes.empty() && spectrum.has_value())
+      spectrum->draw(user_probe_colors);
 
     auto text_pos_x = 10;
     auto text_pos_y = 10;
 
-    auto fps_text = std::format("FPS: {}", w.GetFPS());
-    raylib::DrawText(fps_text, text_pos_x, text_pos_y, FONT_SIZE, textColor);
+    fps_label.update(w.GetFPS());
+    fps_label.draw(text_pos_x, text_pos_y, textColor);
 
-    auto window_text =
-        std::format("Window size: {}x{}", w.GetWidth(), w.GetHeight());
-    raylib::DrawText(
-        window_text, text_pos_x, text_pos_y + FONT_SIZE, FONT_SIZE, textColor
-    );
+    window_label.update(w.GetWidth(), w.GetHeight());
+    window_label.draw(text_pos_x, text_pos_y + FONT_SIZE, textColor);
 
-    auto scenario_text = std::format("Scenario: {}", scenario);
-    raylib::DrawText(
-        scenario_text,
-        text_pos_x,
-        text_pos_y + 2 * FONT_SIZE,
-        FONT_SIZE,
-        textColor
-    );
+    static_text.draw(screen_size);
 
     float bottom_edge = static_cast<float>(w.GetHeight() - 45);
 
@@ -404,13 +665,8 @@ int main(int argc, char const *argv[]) {
     auto button_active =
         fast_button_state || slow_button_state || normal_speed_button_state;
 
-    raylib::DrawText(
-        std::format("Speed: {:.4g}x", simulation_speed),
-        text_pos_x,
-        bottom_edge - FONT_SIZE - 5,
-        FONT_SIZE,
-        textColor
-    );
+    speed_label.update(simulation_speed);
+    speed_label.draw(text_pos_x, bottom_edge - FONT_SIZE - 5, textColor);
 
     auto mouse_in_world = get_mouse_in_world(camera);
     auto shift_down = raylib::Keyboard::IsKeyDown(KEY_LEFT_SHIFT) ||
@@ -452,6 +708,7 @@ int main(int argc, char const *argv[]) {
         }
       } else {
         charges[*selected_charge_idx].position(mouse_in_world);
+        charges[*selected_charge_idx].velocity({0.f, 0.f});
       }
     } else {
       selected_charge_idx = std::nullopt;
@@ -481,6 +738,8 @@ int main(int argc, char const *argv[]) {
             })) {
           user_probes.clear();
           plot.clear();
+          if (spectrum.has_value())
+            spectrum->clear();
           wanted_target += raylib::Vector2{0.f, half_screen_size.y / 8.f};
           resize_grid();
         }
@@ -491,7 +750,7 @@ int main(int argc, char const *argv[]) {
           user_probe_colors.push_back(generate_random_color());
 
         user_probes.emplace_back(Probe{
-            std::make_unique<position::Static>(mouse_in_world),
+            position::Static(mouse_in_world),
             user_probe_colors[user_probes.size()],
             8.f,
             50.f
@@ -1,38 +1,91 @@
 #include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+namespace {
+
+/// Requested number of threads, `0` for the hardware threads
+std::atomic<size_t> requested_threads = 0;
+/// Set on the workers of the scheduler, their loops run serially
+thread_local bool on_worker = false;
+
+} // namespace
+
+void set_thread_count(const size_t count) { requested_threads = count; }
+
+size_t thread_count() {
+  // Fixed by the first call, so the pool and the loops agree on it
+  static const size_t count = [] {
+    const size_t requested = requested_threads;
+    if (requested > 0)
+      return requested;
+
+    const size_t hint = std::thread::hardware_concurrency();
+    return hint == 0 ? size_t{8} : hint;
+  }();
+  return count;
+}
+
+ThreadPool &scheduler() {
+  // The calling thread of a loop works on it too
+  static ThreadPool pool{std::max<size_t>(thread_count() - 1, 1)};
+  return pool;
+}
 
-// adapted from https://stackoverflow.com/a/49188371
 void for_each(
     size_t nb_elements,
     std::function<void(size_t start, size_t end)> functor,
-    bool use_threads = true
+    bool use_threads
 ) {
-  size_t nb_threads_hint = std::thread::hardware_concurrency();
-  size_t thread_count = nb_threads_hint == 0 ? 8 : nb_threads_hint;
-
-  size_t batch_size = nb_elements / thread_count;
-  size_t batch_remainder = nb_elements % thread_count;
+  const auto threads = thread_count();
 
-  if (!use_threads) {
+  if (!use_threads || threads <= 1 || nb_elements < 2 || on_worker) {
     // Single thread execution (for easy debugging)
-    for (size_t i = 0; i < thread_count; ++i) {
-      size_t start = i * batch_size;
-      functor(start, start + batch_size);
-    }
+    functor(0, nb_elements);
     return;
   }
 
-  std::vector<std::jthread> threads(thread_count);
-  if (use_threads) {
-    // Multithreaded execution
-    for (unsigned i = 0; i < thread_count; ++i) {
-      size_t start = i * batch_size;
-      threads[i] = std::jthread(functor, start, start + batch_size);
-    }
+  const auto chunks = std::min(threads, nb_elements);
+  const auto chunk_size = nb_elements / chunks;
+  const auto chunk_remainder = nb_elements % chunks;
+
+  std::vector<std::future<void>> pending{};
+  pending.reserve(chunks - 1);
+
+  size_t start = 0;
+  for (size_t i = 0; i + 1 < chunks; ++i) {
+    const auto end = start + chunk_size + (i < chunk_remainder ? 1 : 0);
+    pending.push_back(scheduler().enqueue([&functor, start, end] {
+      on_worker = true;
+      functor(start, end);
+    }));
+    start = end;
   }
 
-  // Handle the remaining elements
-  size_t start = thread_count * batch_size;
-  functor(start, start + batch_remainder);
+  // The last chunk runs here, the others still use `functor` until they're
+  // done, even when it throws
+  std::exception_ptr error = nullptr;
+  try {
+    functor(start, nb_elements);
+  } catch (...) {
+    error = std::current_exception();
+  }
 
-  // jthreads are automatically awaited at the end of the scope
+  for (auto &chunk : pending) {
+    chunk.wait();
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+  for (auto &chunk : pending) {
+    chunk.get();
+  }
 }
+
+} // namespace parallel
@@ -1,16 +1,26 @@
 #pragma once
 #include <ThreadPool.h>
-#include <algorithm>
+#include <cstddef>
 #include <functional>
-#include <ranges>
 #include <span>
-#include <thread>
-#include <vector>
 
 namespace parallel {
 
-namespace views = std::views;
-namespace ranges = std::ranges;
+/**
+ * @brief Set the number of threads working on a parallel loop
+ *
+ * The loops are split among the calling thread and a single pool of
+ * `count - 1` workers shared by the whole process. `0` picks the number of
+ * hardware threads. The pool is started on the first parallel loop, so this
+ * has no effect once one ran.
+ */
+void set_thread_count(const size_t count);
+/// Number of threads working on a parallel loop, including the caller
+size_t thread_count();
+
+/// The shared pool of workers, started on the first call. It's shut down
+/// at exit, after finishing the queued work.
+ThreadPool &scheduler();
 
 /// @param nb_elements : size of your for loop
 /// @param functor(start, end) :
@@ -22,6 +32,10 @@ namespace ranges = std::ranges;
 /// @endcode
 /// @param use_threads : enable / disable threads (for debugging purposes).
 ///
+/// Chunks run on the workers of the `scheduler` and the calling thread. Loops
+/// started from within a chunk run on their calling thread only, so workers
+/// never wait for each other.
+///
 /// @safety Each thread only receives it's own range of input values, but it's
 /// up to the user provided function to not access elements outside of that
 /// range, or to not invalidate any references or pointers, etc.
@@ -31,16 +45,13 @@ void for_each(
     bool use_threads = true
 );
 
-static ThreadPool pool{std::thread::hardware_concurrency()};
-
 /// @param span : a span containing target elements
 /// @param functor(index, item) :
 /// your function processing a single item from the span.
 /// @param use_threads : enable / disable threads (for debugging purposes).
 ///
-/// This doesn't spawn a new thread for each element. It instead spawns just
-/// enough threads to fully utilize the CPU and distributes the work among
-/// them.
+/// This doesn't spawn a new thread for each element. It instead splits the
+/// span into one chunk per thread of the `scheduler`, see above.
 ///
 /// @safety Each thread only receives it's own range of input values, but it's
 /// up to the user provided function to not access elements outside of that
@@ -51,29 +62,13 @@ void for_each(
     std::function<void(const size_t index, T &value)> functor,
     const bool use_threads = true
 ) {
-  size_t thread_count_hint = std::thread::hardware_concurrency();
-  size_t thread_count = thread_count_hint == 0 ? 8 : thread_count_hint;
-
-  size_t batch_size = span.size() / thread_count;
-
-  if (!use_threads) {
-    // Single thread execution (for easy debugging)
-    for (auto [i, item] : span | views::enumerate)
-      functor(i, item);
-
-    return;
-  }
-
-  ranges::for_each(
-      span | views::enumerate | views::chunk(batch_size) |
-          views::transform([&functor](auto chunk) {
-            return pool.enqueue([&functor, chunk]() {
-              for (auto [i, item] : chunk)
-                functor(i, item);
-            });
-          }) |
-          ranges::to<std::vector>(),
-      [](auto &handle) { handle.wait(); }
+  for_each(
+      span.size(),
+      [&](size_t start, size_t end) {
+        for (size_t i = start; i < end; ++i)
+          functor(i, span[i]);
+      },
+      use_threads
   );
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <Color.hpp>
+#include <cmath>
 #include <string>
 
 /**
@@ -69,4 +70,19 @@ inline raylib::Color lerpColor3(
  */
 inline float sigmoid(float x) { return x / (1.f + std::abs(x)); }
 
+/**
+ * @brief Round to the given number of significant digits
+ *
+ * Values that display the same with that precision compare equal, so they
+ * can be used as keys of cached labels.
+ */
+inline float round_significant(float x, int digits) {
+  if (x == 0.f || !std::isfinite(x))
+    return x;
+
+  auto scale =
+      std::pow(10.f, digits - 1 - std::floor(std::log10(std::abs(x))));
+  return std::round(x * scale) / scale;
+}
+
 std::string_view trim(const std::string_view str);